@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""Decoder for bus scope datagrams sent by the Arduino Altherma UDP Controller.
+
+Listens for scope datagrams (see "Bus Scope" in README.md), decodes bytes read
+from the P1/P2 bus and prints the timing of each bit relative to the start bit.
+Edges written by the controller are printed as pulse widths.
+
+    python3 Bus-scope-decoder.py [--port 10001] [--raw]
+"""
+
+import argparse
+import socket
+import struct
+
+SCOPE_MARKER = 0x53
+BIT_US = 1e6 / 9600  # nominal bit time at 9600 baud
+
+EVENT_MASK = 0xE0
+SIGNAL_HIGH_R = 0x80
+EDGE_FALLING_W = 0x40
+EDGE_FALLING_R = 0xC0
+EDGE_RISING = 0x60
+EDGE_SPIKE = 0xA0
+
+EVENT_NAMES = {
+    SIGNAL_HIGH_R: "high (read)",
+    EDGE_FALLING_W: "falling (write)",
+    EDGE_FALLING_R: "falling (read)",
+    EDGE_RISING: "rising",
+    EDGE_SPIKE: "spike",
+}
+
+ERROR_NAMES = {
+    0xFF: "start bit error",
+    0xFE: "bit collision",
+    0xFD: "parity error",
+    0xFC: "bus error",
+    0xFB: "fake start bit error",
+    0xFA: "fake bit collision",
+    0xF9: "fake parity error",
+    0xF8: "fake bus error",
+    0xF7: "signal low for too long",
+}
+
+
+def parse(datagram):
+    """Returns (seq, dropped, wrapped, events), events are (time_us, code), oldest first."""
+    if len(datagram) < 6 or datagram[0] != SCOPE_MARKER:
+        raise ValueError("not a scope datagram")
+    seq, ticks_us, count, dropped = struct.unpack_from("<BBHB", datagram, 1)
+    wrapped = bool(count & 0x8000)
+    count &= 0x7FFF
+    if len(datagram) < 6 + 3 * count:
+        raise ValueError("truncated datagram (%d events announced)" % count)
+    events = []
+    time_ticks = 0
+    prev = None
+    for i in range(count):
+        capture, code = struct.unpack_from("<HB", datagram, 6 + 3 * i)
+        # captures come from a free running 16-bit timer, consecutive events are less than one wrap apart
+        if prev is not None:
+            time_ticks += (capture - prev) & 0xFFFF
+        prev = capture
+        events.append((time_ticks / ticks_us, code))
+    return seq, dropped, wrapped, events
+
+
+def describe(code):
+    if code >= 0xF7:
+        return ERROR_NAMES.get(code, "error 0x%02X" % code)
+    return "%s, state %d" % (EVENT_NAMES.get(code & EVENT_MASK, "0x%02X" % code), code & 0x1F)
+
+
+def decode_read(events):
+    """Rebuilds bytes read from the bus. Yields (start_us, byte, parity_ok, bit_offsets, notes)."""
+    start = None
+    for t, code in events:
+        if code >= 0xF7:
+            if start is not None:
+                start[4].append(ERROR_NAMES.get(code, "error 0x%02X" % code))
+            continue
+        kind = code & EVENT_MASK
+        state = code & 0x1F
+        if kind == EDGE_SPIKE:
+            if start is not None:
+                start[4].append("spike at %+.1f us" % (t - start[0]))
+            continue
+        if kind == EDGE_FALLING_R and state < 2:
+            # start bit: [start time, data bits, parity bit, offsets of falling edges, notes]
+            start = [t, [None] * 8, None, [], []]
+            continue
+        if start is None or kind not in (EDGE_FALLING_R, SIGNAL_HIGH_R):
+            continue
+        bit = 1 if kind == SIGNAL_HIGH_R else 0
+        if kind == EDGE_FALLING_R:
+            # falling edge should come (state - 1) bit times after the start bit edge
+            start[3].append(t - start[0] - (state - 1) * BIT_US)
+        if 2 <= state <= 9:
+            start[1][state - 2] = bit
+        elif state == 10:
+            start[2] = bit
+        elif state == 11:
+            data_bits = start[1]
+            value = sum((b or 0) << i for i, b in enumerate(data_bits))
+            parity_ok = start[2] is not None and (sum(b or 0 for b in data_bits) + start[2]) % 2 == 0
+            if None in data_bits:
+                start[4].append("missing bits")
+            yield start[0], value, parity_ok, start[3], start[4]
+            start = None
+
+
+def print_writes(events):
+    low = None
+    pulses = []
+    for t, code in events:
+        kind = code & EVENT_MASK
+        if code < 0xF7 and kind == EDGE_FALLING_W:
+            low = t
+        elif code < 0xF7 and kind == EDGE_RISING and low is not None:
+            pulses.append((low, t - low))
+            low = None
+    if pulses:
+        print("  written pulses (start us / width us): " +
+              " ".join("%.0f/%.1f" % p for p in pulses))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=10001, help="UDP Port + SCOPE_PORT_OFFSET (default 10001)")
+    parser.add_argument("--bind", default="", help="local address to listen on (default all)")
+    parser.add_argument("--raw", action="store_true", help="also print every event")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind((args.bind, args.port))
+    last_seq = None
+    while True:
+        datagram, sender = sock.recvfrom(2048)
+        try:
+            seq, dropped, wrapped, events = parse(datagram)
+        except ValueError as e:
+            print("%s: %s" % (sender[0], e))
+            continue
+        lost = "" if last_seq is None or seq == (last_seq + 1) & 0xFF else ", datagrams lost"
+        last_seq = seq
+        print("#%d from %s: %d events, dropped by library %d%s%s" % (
+            seq, sender[0], len(events), dropped, ", oldest events lost" if wrapped else "", lost))
+        if args.raw:
+            for t, code in events:
+                print("  %9.1f us  0x%02X  %s" % (t, code, describe(code)))
+        decoded = list(decode_read(events))
+        if decoded:
+            print("  read: " + " ".join("%02X" % d[1] for d in decoded))
+        for start_us, value, parity_ok, offsets, notes in decoded:
+            worst = max(offsets, key=abs) if offsets else 0.0
+            print("  %9.1f us  %02X  parity %s  falling edges %d, worst %+.1f us%s" % (
+                start_us, value, "ok" if parity_ok else "ERR", len(offsets), worst,
+                "  " + "; ".join(notes) if notes else ""))
+        print_writes(events)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,25 +1,44 @@
 /**************************************************************************/
 /*!
-  @brief Initiates ethernet interface, if DHCP enabled, gets IP from DHCP,
-  starts all servers (UDP, web server).
+  @brief Resets ethernet shield (if ETH_RESET_PIN is defined), non-blocking.
+  Ethernet interface is initiated by beginEthernet() from loop() once the
+  shield is ready (ETH_RESET_DELAY), sockets are not used until then.
+  In setup(), beginEthernet() is called right away (the Ethernet library
+  waits for the shield in its first init).
 */
 /**************************************************************************/
 void startEthernet() {
+  ethReady = false;
+#ifdef ENABLE_DHCP
+  dhcpUdp.stop();  // release the DHCP socket (if any)
+  dhcpState = DHCP_OFF;
+  dhcpNeedsSocket = false;
+#endif /* ENABLE_DHCP */
 #ifdef ETH_RESET_PIN
   pinMode(ETH_RESET_PIN, OUTPUT);
   digitalWrite(ETH_RESET_PIN, LOW);
   delay(25);
   digitalWrite(ETH_RESET_PIN, HIGH);
-  delay(ETH_RESET_DELAY);
+  ethTimer.sleep(ETH_RESET_DELAY);
+#else
+  ethTimer.sleep(0);
 #endif
+}
 
+/**************************************************************************/
+/*!
+  @brief Initiates ethernet interface with static IP, starts all servers (UDP,
+  web server). If DHCP is enabled, the lease is requested later by manageDhcp().
+*/
+/**************************************************************************/
+void beginEthernet() {
 #ifdef ENABLE_DHCP
   dhcpSuccess = false;
+  Ethernet.begin(data.mac, data.config.ip, data.config.dns, data.config.gateway, data.config.subnet);  // fallback static IP until DHCP lease is obtained
+  dhcpState = DHCP_OFF;
   if (data.config.enableDhcp) {
-    dhcpSuccess = Ethernet.begin(data.mac);
-  }
-  if (!dhcpSuccess) {
-    Ethernet.begin(data.mac, data.config.ip, data.config.dns, data.config.gateway, data.config.subnet);
+    dhcpState = DHCP_INIT;
+    dhcpTimer.sleep(0);
   }
 #else  /* ENABLE_DHCP */
   Ethernet.begin(data.mac, data.config.ip, {}, data.config.gateway, data.config.subnet);  // No DNS
@@ -33,7 +52,216 @@ void startEthernet() {
 #if MAX_SOCK_NUM > 4
   if (W5100.getChip() == 51) maxSockNum = 4;  // W5100 chip never supports more than 4 sockets
 #endif
+  ethReady = true;
+#ifdef ENABLE_EXTENDED_WEBUI
+  bootStage(BOOT_ETHERNET);
+#endif /* ENABLE_EXTENDED_WEBUI */
+}
+
+#ifdef ENABLE_DHCP
+/**************************************************************************/
+/*!
+  @brief DHCP client state machine, runs in small non-blocking steps (sends
+  one request or processes one response). Fallback static IP is used until
+  the lease is obtained and after the lease expires.
+*/
+/**************************************************************************/
+void manageDhcp() {
+  switch (dhcpState) {
+    case DHCP_INIT:
+    case DHCP_BOUND:
+      if (dhcpTimer.isOver() == false) break;
+      if (dhcpUdp.begin(DHCP_CLIENT_PORT) == 0) {  // no free socket
+        dhcpNeedsSocket = true;                    // manageSockets() frees one, retry as soon as it is closed
+        dhcpTimer.sleep(TCP_DISCON_TIMEOUT);
+        break;
+      }
+      dhcpNeedsSocket = false;
+      dhcpXid = micros() ^ (uint32_t(data.mac[3]) << 16) ^ (uint32_t(data.mac[4]) << 8) ^ data.mac[5];
+      if (dhcpState == DHCP_INIT) {
+        dhcpState = DHCP_SELECTING;
+        sendDhcp(DHCP_DISCOVER);
+      } else {
+        dhcpState = DHCP_RENEWING;
+        sendDhcp(DHCP_REQUEST);
+      }
+      dhcpTimer.sleep(DHCP_RESPONSE_TIMEOUT);
+      break;
+    case DHCP_SELECTING:
+    case DHCP_REQUESTING:
+    case DHCP_RENEWING:
+      recvDhcp();
+      if (dhcpState == DHCP_BOUND || dhcpState == DHCP_INIT || dhcpTimer.isOver() == false) break;
+      // no response from the DHCP server
+      dhcpUdp.stop();
+      if (dhcpState == DHCP_RENEWING && dhcpLeaseTimer.isOver() == false) {
+        dhcpState = DHCP_BOUND;  // keep the lease, try to renew later
+      } else {
+        stopDhcp();
+      }
+      dhcpTimer.sleep(DHCP_RETRY_INTERVAL);
+      break;
+    default:
+      break;
+  }
+}
+
+/**************************************************************************/
+/*!
+  @brief Sends DHCP message (broadcast) to the DHCP server.
+  @param type DHCP message type (DHCP_DISCOVER or DHCP_REQUEST).
+*/
+/**************************************************************************/
+void sendDhcp(const byte type) {
+  byte buf[16];
+  memset(buf, 0, sizeof(buf));
+  dhcpUdp.beginPacket(IPAddress(255, 255, 255, 255), DHCP_SERVER_PORT);
+  buf[0] = 1;  // op: BOOTREQUEST
+  buf[1] = 1;  // htype: Ethernet
+  buf[2] = 6;  // hlen
+  for (byte i = 0; i < 4; i++) {
+    buf[4 + i] = byte(dhcpXid >> (24 - (8 * i)));
+  }
+  buf[10] = 0x80;  // flags: broadcast (we can not receive unicast to the offered IP yet)
+  if (dhcpState == DHCP_RENEWING) memcpy(buf + 12, dhcpOffer, 4);  // ciaddr
+  dhcpUdp.write(buf, 16);
+  memset(buf, 0, sizeof(buf));
+  dhcpUdp.write(buf, 12);  // yiaddr, siaddr, giaddr
+  dhcpUdp.write(data.mac, 6);
+  for (byte i = 0; i < 12; i++) {
+    dhcpUdp.write(buf, 16);  // chaddr padding, sname, file
+  }
+  dhcpUdp.write(buf, 10);
+  byte options[] = {
+    99, 130, 83, 99,  // magic cookie
+    53, 1, type,      // DHCP message type
+    55, 3, 1, 3, 6,   // parameter request list: subnet, router, DNS
+    61, 7, 1          // client identifier: Ethernet + MAC
+  };
+  dhcpUdp.write(options, sizeof(options));
+  dhcpUdp.write(data.mac, 6);
+  if (dhcpState == DHCP_REQUESTING) {
+    buf[0] = 50;  // requested IP address
+    buf[1] = 4;
+    memcpy(buf + 2, dhcpOffer, 4);
+    buf[6] = 54;  // server identifier
+    buf[7] = 4;
+    memcpy(buf + 8, dhcpServer, 4);
+    dhcpUdp.write(buf, 12);
+  }
+  dhcpUdp.write(byte(255));  // end
+  dhcpUdp.endPacket();
+}
+
+/**************************************************************************/
+/*!
+  @brief Processes DHCP response (if available): sends DHCPREQUEST upon
+  DHCPOFFER, applies IP settings upon DHCPACK, falls back to static IP
+  upon DHCPNAK.
+*/
+/**************************************************************************/
+void recvDhcp() {
+  if (dhcpUdp.parsePacket() < 240) return;
+  byte buf[16];
+  dhcpUdp.read(buf, 8);     // op, htype, hlen, hops, xid
+  if (buf[0] != 2) return;  // op: BOOTREPLY
+  for (byte i = 0; i < 4; i++) {
+    if (buf[4 + i] != byte(dhcpXid >> (24 - (8 * i)))) return;
+  }
+  dhcpUdp.read(buf, 12);  // secs, flags, ciaddr, yiaddr
+  byte yiaddr[4];
+  memcpy(yiaddr, buf + 8, 4);
+  dhcpUdp.read(buf, 8);   // siaddr, giaddr
+  dhcpUdp.read(buf, 16);  // chaddr
+  if (memcmp(buf, data.mac, 6) != 0) return;
+  for (byte i = 0; i < 14; i++) {
+    dhcpUdp.read(buf, 14);  // sname, file, magic cookie
+  }
+  byte type = 0;
+  byte server[4] = {};
+  byte subnet[4];
+  byte gateway[4];
+  byte dns[4];
+  memcpy(subnet, data.config.subnet, 4);
+  memcpy(gateway, data.config.gateway, 4);
+  memcpy(dns, data.config.dns, 4);
+  uint32_t lease = 0;
+  while (dhcpUdp.available() > 0) {
+    byte code = dhcpUdp.read();
+    if (code == 255) break;   // end
+    if (code == 0) continue;  // pad
+    byte len = dhcpUdp.read();
+    for (byte i = 0; i < len; i++) {
+      byte value = dhcpUdp.read();
+      if (i < sizeof(buf)) buf[i] = value;
+    }
+    if (len < 4 && code != 53) continue;
+    switch (code) {
+      case 53:  // DHCP message type
+        type = buf[0];
+        break;
+      case 1:  // subnet mask
+        memcpy(subnet, buf, 4);
+        break;
+      case 3:  // router
+        memcpy(gateway, buf, 4);
+        break;
+      case 6:  // DNS
+        memcpy(dns, buf, 4);
+        break;
+      case 51:  // lease time (s)
+        lease = (uint32_t(buf[0]) << 24) | (uint32_t(buf[1]) << 16) | (uint32_t(buf[2]) << 8) | buf[3];
+        break;
+      case 54:  // server identifier
+        memcpy(server, buf, 4);
+        break;
+      default:
+        break;
+    }
+  }
+  if (type == DHCP_OFFER && dhcpState == DHCP_SELECTING) {
+    memcpy(dhcpOffer, yiaddr, 4);
+    memcpy(dhcpServer, server, 4);
+    dhcpState = DHCP_REQUESTING;
+    sendDhcp(DHCP_REQUEST);
+    dhcpTimer.sleep(DHCP_RESPONSE_TIMEOUT);
+  } else if (type == DHCP_ACK && (dhcpState == DHCP_REQUESTING || dhcpState == DHCP_RENEWING)) {
+    dhcpUdp.stop();
+    memcpy(dhcpOffer, yiaddr, 4);
+    Ethernet.setLocalIP(dhcpOffer);
+    Ethernet.setSubnetMask(subnet);
+    Ethernet.setGatewayIP(gateway);
+    Ethernet.setDnsServerIP(dns);
+    dhcpSuccess = true;
+#ifdef ENABLE_EXTENDED_WEBUI
+    bootStage(BOOT_DHCP);
+#endif /* ENABLE_EXTENDED_WEBUI */
+    dhcpState = DHCP_BOUND;
+    if (lease == 0 || lease > DHCP_LEASE_MAX) lease = DHCP_LEASE_MAX;  // infinite lease or longer than Timer can handle
+    dhcpLeaseTimer.sleep(lease * 1000);
+    dhcpTimer.sleep(lease * 500);  // renewal time T1 (50% of the lease)
+  } else if (type == DHCP_NAK) {
+    dhcpUdp.stop();
+    stopDhcp();
+    dhcpTimer.sleep(0);
+  }
+}
+
+/**************************************************************************/
+/*!
+  @brief Drops DHCP lease, restores fallback static IP settings.
+*/
+/**************************************************************************/
+void stopDhcp() {
+  dhcpState = DHCP_INIT;
+  if (dhcpSuccess == false) return;
+  dhcpSuccess = false;
+  Ethernet.setLocalIP(data.config.ip);
+  Ethernet.setSubnetMask(data.config.subnet);
+  Ethernet.setGatewayIP(data.config.gateway);
+  Ethernet.setDnsServerIP(data.config.dns);
 }
+#endif /* ENABLE_DHCP */
 
 /**************************************************************************/
 /*!
@@ -42,6 +270,104 @@ void startEthernet() {
 /**************************************************************************/
 void (*resetFunc)(void) = 0;  //declare reset function at address 0
 
+/**************************************************************************/
+/*!
+  @brief Task: manages controller state, requests, write tokens.
+*/
+/**************************************************************************/
+void taskController() {
+  manageController();
+  refillTokens();
+}
+
+/**************************************************************************/
+/*!
+  @brief Task: resets counters before they roll over, periodically saves
+  data to EEPROM.
+*/
+/**************************************************************************/
+void taskEeprom() {
+  if (rollover()) {
+    resetStats();
+    updateEeprom();
+  }
+  if (EEPROM_INTERVAL > 0 && eepromTimer.isOver() == true) {
+    updateEeprom();
+  }
+}
+
+#ifdef ENABLE_EXTENDED_WEBUI
+/**************************************************************************/
+/*!
+  @brief Task: maintains uptime.
+*/
+/**************************************************************************/
+void taskMaintain() {
+  maintainUptime();  // maintain uptime in case of millis() overflow
+}
+#endif /* ENABLE_EXTENDED_WEBUI */
+
+// Periodic tasks run by runTasks() when due, in order of priority. recvBus() is called before each task.
+typedef struct {
+  void (*run)();    // task function
+  uint16_t period;  // ms
+  uint16_t budget;  // expected duration (us), task waits for the next loop() pass if the pass would exceed LOOP_BUDGET
+  byte stage;       // loop latency profiler stage
+} task_t;
+const task_t TASKS[] = {
+  { taskController, 50, 500, STAGE_CONTROLLER },  // controller state, counter and name requests, write tokens
+  { taskEeprom, 1000, 200, STAGE_EEPROM },        // counters rollover, periodic EEPROM update
+#ifdef ENABLE_DHCP
+  { manageDhcp, 100, 1000, STAGE_DHCP },          // DHCP lease (one request or response per run)
+#endif /* ENABLE_DHCP */
+#ifdef ENABLE_EXTENDED_WEBUI
+  { taskMaintain, 1000, 100, STAGE_MAINTAIN },    // uptime
+#endif /* ENABLE_EXTENDED_WEBUI */
+};
+const byte TASKS_CNT = sizeof(TASKS) / sizeof(TASKS[0]);
+Timer taskTimer[TASKS_CNT];
+
+/**************************************************************************/
+/*!
+  @brief Runs periodic tasks (TASKS) which are due, in order of priority.
+  Pending P1P2 packets are processed before each task. Once a task has run,
+  lower priority tasks which would exceed LOOP_BUDGET wait for the next
+  loop() pass.
+  @param loopStart Time (micros) when the loop() pass started.
+*/
+/**************************************************************************/
+void runTasks(const uint32_t loopStart) {
+  bool ran = false;
+  for (byte i = 0; i < TASKS_CNT; i++) {
+    if (taskTimer[i].isOver() == false) continue;
+    if (ran && micros() - loopStart + TASKS[i].budget > LOOP_BUDGET) break;
+    if (P1P2Serial.packetavailable()) recvBus();
+    taskTimer[i].sleep(TASKS[i].period);
+#ifdef ENABLE_EXTENDED_WEBUI
+    uint32_t start = micros();
+#endif /* ENABLE_EXTENDED_WEBUI */
+    TASKS[i].run();
+#ifdef ENABLE_EXTENDED_WEBUI
+    profile(TASKS[i].stage, start);
+#endif /* ENABLE_EXTENDED_WEBUI */
+    ran = true;
+  }
+}
+
+#ifdef ENABLE_EXTENDED_WEBUI
+/**************************************************************************/
+/*!
+  @brief Records time of the boot stage (only the first occurrence).
+  @param stage Boot stage
+*/
+/**************************************************************************/
+void bootStage(const byte stage) {
+  if (bootDone & (1 << stage)) return;
+  bootDone |= (1 << stage);
+  bootTime[stage] = millis();
+}
+#endif /* ENABLE_EXTENDED_WEBUI */
+
 /**************************************************************************/
 /*!
   @brief Maintains uptime in case of millis() overflow.
@@ -61,6 +387,49 @@ void maintainUptime() {
   //We add the "remaining_seconds", so that we can continue measuring the time passed from the last boot of the device.
   seconds = (milliseconds / 1000) + remaining_seconds;
 }
+
+/**************************************************************************/
+/*!
+  @brief Records duration of a loop() stage in the latency profiler.
+  @param stage Loop stage (stage_t).
+  @param start Time (micros) when the stage started.
+  @return Current time (micros), start of the next stage.
+*/
+/**************************************************************************/
+uint32_t profile(const byte stage, const uint32_t start) {
+  uint32_t now = micros();
+  uint32_t duration = now - start;
+  if (duration < latency[stage].min) latency[stage].min = duration;
+  if (duration > latency[stage].max) latency[stage].max = duration;
+  latency[stage].sum += duration;
+  byte bucket = 0;
+  for (uint32_t i = duration >> 6; i > 0 && bucket < LATENCY_BUCKETS - 1; i >>= 1) {
+    bucket++;
+  }
+  latency[stage].hist[bucket]++;
+  static byte passStage = STAGE_LOOP;
+  static uint32_t passDuration = 0;
+  if (stage == STAGE_LOOP) {
+    slowStage = passStage;
+    passDuration = 0;
+  } else if (duration > passDuration) {
+    passStage = stage;
+    passDuration = duration;
+  }
+  return now;
+}
+
+/**************************************************************************/
+/*!
+  @brief Resets loop latency profiler.
+*/
+/**************************************************************************/
+void resetLatency() {
+  memset(latency, 0, sizeof(latency));
+  for (byte i = 0; i < STAGE_LAST; i++) {
+    latency[i].min = 0xFFFFFFFF;
+  }
+}
 #endif /* ENABLE_EXTENDED_WEBUI */
 
 /**************************************************************************/
@@ -99,6 +468,22 @@ void resetStats() {
 #ifdef ENABLE_EXTENDED_WEBUI
   memset(data.udpCnt, 0, sizeof(data.udpCnt));
   remaining_seconds = -(millis() / 1000);
+  memset(replyCnt, 0, sizeof(replyCnt));
+  memset(replyLag, 0, sizeof(replyLag));
+  replyLagSum = 0;
+  memset(replyLateStage, 0, sizeof(replyLateStage));
+  memset(responseDelay, 0, sizeof(responseDelay));
+  memset(responseDelaySum, 0, sizeof(responseDelaySum));
+  memset(cycle, 0, sizeof(cycle));
+  busBits = 0;
+  busStart = millis();  // learned reply delays (otherDelay, delayBackoff) are not statistics
+  memset(confirmCnt, 0, sizeof(confirmCnt));
+  memset(confirmTime, 0, sizeof(confirmTime));
+  memset(voltage, 0, sizeof(voltage));
+  memset(errorMatrix, 0, sizeof(errorMatrix));
+  memset(bursts, 0, sizeof(bursts));
+  sagCnt = 0;
+  sagErrors = 0;
 #endif /* ENABLE_EXTENDED_WEBUI */
 }
 
@@ -108,7 +493,9 @@ void resetStats() {
 */
 /**************************************************************************/
 void resetEepromStats() {
+  byte tokens = data.eepromDaikin.tokens;  // write tokens are not statistics
   memset(&data.eepromDaikin, 0, sizeof(eeprom_t));
+  data.eepromDaikin.tokens = tokens;
 }
 
 /**************************************************************************/
@@ -118,6 +505,8 @@ void resetEepromStats() {
 */
 /**************************************************************************/
 void generateMac() {
+  while (nrot > 0)
+    ;  // wait until seed is created (only blocks shortly after boot)
   // Marsaglia algorithm from https://github.com/RobTillaart/randomHelpers
   seed1 = 36969L * (seed1 & 65535L) + (seed1 >> 16);
   seed2 = 18000L * (seed2 & 65535L) + (seed2 >> 16);
@@ -140,8 +529,8 @@ void updateEeprom() {
   EEPROM.put(DATA_START, data);
 }
 
-
 uint32_t lastSocketUse[MAX_SOCK_NUM];
+byte partialRequests;  // bitmask of sockets with an incomplete HTTP request in the buffer (lastSocketUse holds the time it was first seen)
 /**************************************************************************/
 /*!
   @brief Closes sockets which are waiting to be closed or which refuse to close,
@@ -161,7 +550,7 @@ void manageSockets() {
   // look at all the hardware sockets, record and take action based on current states
   for (byte s = 0; s < maxSockNum; s++) {            // for each hardware socket ...
     byte status = W5100.readSnSR(s);                 //  get socket status...
-    uint32_t sockAge = millis() - lastSocketUse[s];  // age of the current socket
+    uint32_t sockAge = timeNow - lastSocketUse[s];   // age of the current socket
     switch (status) {
       case SnSR::CLOSED:
         {
@@ -171,7 +560,7 @@ void manageSockets() {
       case SnSR::LISTEN:
       case SnSR::SYNRECV:
         {
-          lastSocketUse[s] = millis();
+          lastSocketUse[s] = timeNow;
           webListening = s;
         }
         break;
@@ -183,26 +572,50 @@ void manageSockets() {
           socketsAvailable++;                  // socket will be available soon
           if (sockAge > TCP_DISCON_TIMEOUT) {  //     if it's been more than TCP_CLIENT_DISCON_TIMEOUT since disconnect command was sent...
             W5100.execCmdSn(s, Sock_CLOSE);    //	    send CLOSE command...
-            lastSocketUse[s] = millis();       //       and record time at which it was sent so we don't do it repeatedly.
+            lastSocketUse[s] = timeNow;        //       and record time at which it was sent so we don't do it repeatedly.
           }
         }
         break;
       case SnSR::ESTABLISHED:
       case SnSR::CLOSE_WAIT:
         {
-          if (EthernetClient(s).available() > 0) {
-            dataAvailable = s;
-            lastSocketUse[s] = millis();
+          uint16_t available = EthernetClient(s).available();
+          if (available > 0) {
+            if (webRequestReady(s, available)) {
+              partialRequests &= ~(1 << s);
+              dataAvailable = s;
+              lastSocketUse[s] = timeNow;
+            } else if (!(partialRequests & (1 << s))) {
+              partialRequests |= (1 << s);  // wait for the rest of the request
+              lastSocketUse[s] = timeNow;
+            } else if (status == SnSR::CLOSE_WAIT || available >= W5100.SSIZE || sockAge > WEB_KEEPALIVE_TIMEOUT) {
+              // request can not be completed (remote host closed connection, request does not fit the buffer or client stalled)
+              partialRequests &= ~(1 << s);
+              disconSocket(s);
+            }
           } else {
             // remote host closed connection, our end still open
             if (status == SnSR::CLOSE_WAIT) {
               socketsAvailable++;               // socket will be available soon
               W5100.execCmdSn(s, Sock_DISCON);  //  send DISCON command...
-              lastSocketUse[s] = millis();      //   record time at which it was sent...
+              lastSocketUse[s] = timeNow;       //   record time at which it was sent...
                                                 // status becomes LAST_ACK for short time
-            } else if ((W5100.readSnPORT(s) == data.config.webPort && sockAge > WEB_IDLE_TIMEOUT) && sockAge > maxAge) {
-              oldest = s;        //     record the socket number...
-              maxAge = sockAge;  //      and make its age the new max age.
+#ifdef ENABLE_EXTENDED_WEBUI
+              releaseStreams(s);
+#endif /* ENABLE_EXTENDED_WEBUI */
+            } else if (W5100.readSnPORT(s) == data.config.webPort
+#ifdef ENABLE_EXTENDED_WEBUI
+                       && s != eventSocket    // event stream is idle by design (client never sends data)
+                       && s != historySocket  // history download is in progress
+#endif                                        /* ENABLE_EXTENDED_WEBUI */
+            ) {
+              if (sockAge > WEB_KEEPALIVE_TIMEOUT) {  // persistent connection idle for too long
+                socketsAvailable++;                   // socket will be available soon
+                disconSocket(s);
+              } else if (sockAge > WEB_IDLE_TIMEOUT && sockAge > maxAge) {
+                oldest = s;        //     record the socket number...
+                maxAge = sockAge;  //      and make its age the new max age.
+              }
             }
           }
         }
@@ -221,14 +634,75 @@ void manageSockets() {
     webServer.begin();
   }
 
-  // If needed, disconnect socket that's been idle (ESTABLISHED without data recieved) the longest
-  if (oldest != MAX_SOCK_NUM && socketsAvailable == 0 && webListening == MAX_SOCK_NUM) {
-    disconSocket(oldest);
+  // If needed (no listening web socket or no socket for the DHCP client), disconnect socket that's been idle (ESTABLISHED without data recieved) the longest
+#ifdef ENABLE_DHCP
+  if (socketsAvailable == 0 && (webListening == MAX_SOCK_NUM || dhcpNeedsSocket)) {
+#else  /* ENABLE_DHCP */
+  if (socketsAvailable == 0 && webListening == MAX_SOCK_NUM) {
+#endif /* ENABLE_DHCP */
+#ifdef ENABLE_EXTENDED_WEBUI
+    if (oldest == MAX_SOCK_NUM) oldest = eventSocket;  // close the event stream only as the last resort
+#endif                                                 /* ENABLE_EXTENDED_WEBUI */
+    if (oldest != MAX_SOCK_NUM) disconSocket(oldest);
   }
 
+#ifdef ENABLE_EXTENDED_WEBUI
+  manageEvents();
+  manageHistory();
+#endif /* ENABLE_EXTENDED_WEBUI */
+
   SPI.endTransaction();  // Serves to o release the bus for other devices to access it. Since the ethernet chip is the only device
 }
 
+/**************************************************************************/
+/*!
+  @brief Checks (without reading it) whether the socket buffer holds a complete
+  HTTP request: header terminated by an empty line and the whole body
+  (according to Content-Length).
+  @param s Socket number.
+  @param available Bytes available in the socket buffer.
+  @return True if the request is complete.
+*/
+/**************************************************************************/
+bool webRequestReady(const byte s, const uint16_t available) {
+  static const char key[] PROGMEM = "content-length:";  // lower case
+  uint16_t ptr = W5100.readSnRX_RD(s);
+  uint16_t contentLength = 0;
+  byte lineLen = 0;      // length of the current line (saturated)
+  bool keyMatch = true;  // current line starts with the key (so far)
+  byte buf[32];
+  for (uint16_t i = 0; i < available; i += sizeof(buf)) {
+    uint16_t len = available - i;
+    if (len > sizeof(buf)) len = sizeof(buf);
+    // same as read_data() in the Ethernet library, the socket buffer is a ring
+    uint16_t offset = (ptr + i) & W5100.SMASK;
+    if (W5100.hasOffsetAddressMapping() || offset + len <= W5100.SSIZE) {
+      W5100.read(W5100.RBASE(s) + offset, buf, len);
+    } else {
+      uint16_t size = W5100.SSIZE - offset;
+      W5100.read(W5100.RBASE(s) + offset, buf, size);
+      W5100.read(W5100.RBASE(s), buf + size, len - size);
+    }
+    for (byte j = 0; j < len; j++) {
+      char c = buf[j];
+      if (c == '\r') continue;
+      if (c == '\n') {
+        if (lineLen == 0) return (available - (i + j + 1) >= contentLength);  // empty line: end of the header
+        lineLen = 0;
+        keyMatch = true;
+        continue;
+      }
+      if (lineLen < sizeof(key) - 1) {
+        keyMatch = keyMatch && ((c | 0x20) == char(pgm_read_byte(key + lineLen)));  // case insensitive (for letters, '-' and ':')
+      } else if (keyMatch && c >= '0' && c <= '9') {
+        contentLength = contentLength * 10 + (c - '0');
+      }
+      if (lineLen < 255) lineLen++;
+    }
+  }
+  return false;
+}
+
 /**************************************************************************/
 /*!
   @brief Disconnect or close a socket.
@@ -238,12 +712,30 @@ void manageSockets() {
 void disconSocket(byte s) {
   if (W5100.readSnSR(s) == SnSR::ESTABLISHED) {
     W5100.execCmdSn(s, Sock_DISCON);  // Sock_DISCON does not close LISTEN sockets
-    lastSocketUse[s] = millis();      //   record time at which it was sent...
+    lastSocketUse[s] = timeNow;       //   record time at which it was sent...
   } else {
     W5100.execCmdSn(s, Sock_CLOSE);  //  send DISCON command...
   }
+  partialRequests &= ~(1 << s);
+#ifdef ENABLE_EXTENDED_WEBUI
+  releaseStreams(s);
+#endif /* ENABLE_EXTENDED_WEBUI */
 }
 
+#ifdef ENABLE_EXTENDED_WEBUI
+/**************************************************************************/
+/*!
+  @brief Forgets the event stream and /history download running on a socket
+  which is being closed (socket number can be reused by another client).
+  @param s Socket number.
+*/
+/**************************************************************************/
+void releaseStreams(byte s) {
+  if (s == eventSocket) eventSocket = MAX_SOCK_NUM;
+  if (s == historySocket) historySocket = MAX_SOCK_NUM;
+}
+#endif /* ENABLE_EXTENDED_WEBUI */
+
 /**************************************************************************/
 /*!
   @brief Maintains connection to the P1P2 bus.
@@ -251,6 +743,25 @@ void disconSocket(byte s) {
 /**************************************************************************/
 void manageController() {
   uint8_t controllerState = controllerAddr;
+#ifdef ENABLE_EXTENDED_WEBUI
+  // measure time to connect
+  static byte prevState = DISCONNECTED;
+  if (controllerState == CONNECTING && prevState != CONNECTING) {
+    connectStart = millis();
+  } else if (controllerState > CONNECTING && prevState == CONNECTING) {
+    connectTime = millis() - connectStart;
+  }
+  prevState = controllerState;
+  expireCommands();
+  if (hwID && voltageTimer.isOver()) {
+    voltageTimer.sleep(VOLTAGE_INTERVAL * 1000UL);
+    sampleVoltage();
+  }
+  if (data.config.summaryMode != SUMMARY_OFF && summaryTimer.isOver()) {
+    summaryTimer.sleep(data.config.summaryPeriod * 60UL * 1000UL);
+    sendSummary();
+  }
+#endif /* ENABLE_EXTENDED_WEBUI */
   // Reset FxRequests periodically
   if (p1p2Timer.isOver()) {
     memset(FxRequests, 0, sizeof(FxRequests));
@@ -276,12 +787,7 @@ void manageController() {
     // Handle counter requests
     if (counterRequestTimer.isOver()) {
       counterRequestTimer.sleep(data.config.counterPeriod * 60UL * 1000UL);
-      cmdQueue.push(2);
-      cmdQueue.push(PACKET_TYPE_COUNTER);
-      cmdQueue.push(0);
-      if (data.config.sendDataPackets == DATA_CHANGE_AND_REQUEST) {
-        memset(savedPackets, 0xFF, sizeof(savedPackets));  // Reset saved packets
-      }
+      requestCounters(false);
     }
     // Handle Daikin names
     if (daikinNameTimer.isOver()) {
@@ -305,6 +811,8 @@ void manageController() {
 /**************************************************************************/
 /*!
   @brief Seed pseudorandom generator using  watch dog timer interrupt (works only on AVR).
+  Non-blocking, the seed is collected in the background by the WDT interrupt
+  (about 0.5 s), generateMac() waits for it if needed.
   See https://sites.google.com/site/astudyofentropy/project-definition/timer-jitter-entropy-sources/entropy-library/arduino-random-seed
 */
 /**************************************************************************/
@@ -318,20 +826,17 @@ void CreateTrulyRandomSeed() {
   _WD_CONTROL_REG |= (1 << _WD_CHANGE_BIT) | (1 << WDE);
   _WD_CONTROL_REG = (1 << WDIE);
   sei();
-  while (nrot > 0)
-    ;  // wait here until seed is created
-  // The following five lines turn off the watch dog timer interrupt
-  cli();
-  MCUSR = 0;
-  _WD_CONTROL_REG |= (1 << _WD_CHANGE_BIT) | (0 << WDE);
-  _WD_CONTROL_REG = (0 << WDIE);
-  sei();
 }
 
 ISR(WDT_vect) {
   nrot--;
   seed1 = seed1 << 8;
   seed1 = seed1 ^ TCNT1L;
+  if (nrot > 0) return;
+  // Seed is created, the following three lines turn off the watch dog timer interrupt
+  MCUSR = 0;
+  _WD_CONTROL_REG |= (1 << _WD_CHANGE_BIT) | (0 << WDE);
+  _WD_CONTROL_REG = (0 << WDIE);
 }
 
 // Preprocessor code for identifying microcontroller board
@@ -15,13 +15,113 @@ void recvUdp() {
       return;
     }
     Udp.read(command, sizeof(command));
-    checkCommand(command, byte(udpLen));
+    if (udpLen == 1 && command[0] == PACKET_TYPE_COUNTER) {  // refresh counters now
+      requestCounters(true);
+    } else if (udpLen == 1 || udpLen == 3) {  // query: packet type (all params) or packet type and param number
+      sendParams(command, byte(udpLen));
+    } else {
+      checkCommand(command, byte(udpLen));
+    }
 #ifdef ENABLE_EXTENDED_WEBUI
     data.udpCnt[UDP_RECEIVED]++;
 #endif /* ENABLE_EXTENDED_WEBUI */
   }
 }
 
+/**************************************************************************/
+/*!
+  @brief Starts a sweep of 0xB8 counter requests, merged with a sweep
+  already in progress. Counter requests are sent in every free time slot.
+  @param full Request all sub-types, otherwise sub-types which do not change
+  are skipped (except every COUNTER_FULL_SWEEP-th sweep).
+*/
+/**************************************************************************/
+void requestCounters(const bool full) {
+  byte sweep = (1 << COUNTER_SUBTYPES) - 1;
+#ifdef ENABLE_EXTENDED_WEBUI
+  if (!full && (++counterSweeps % COUNTER_FULL_SWEEP)) {
+    for (byte i = 0; i < COUNTER_SUBTYPES; i++) {
+      if (counterSame[i] >= COUNTER_STATIC_SWEEPS) sweep &= ~masks[i];
+    }
+  }
+#endif /* ENABLE_EXTENDED_WEBUI */
+  counterSweep |= sweep;
+  if (data.config.sendDataPackets == DATA_CHANGE_AND_REQUEST) {
+    clearSavedPackets();
+  }
+}
+
+/**************************************************************************/
+/*!
+  @brief Replies to UDP query with params mirrored from the bus. Reply
+  starts with the packet type, followed by param number (2 bytes) and
+  param value of each param found (same format as P1P2 command).
+  @param query Packet type, optionally followed by param number (2 bytes).
+  @param len Query length.
+*/
+/**************************************************************************/
+void sendParams(const byte query[], const byte len) {
+  if (query[0] < PACKET_TYPE_CONTROL[FIRST] || query[0] > PACKET_TYPE_CONTROL[LAST]) return;
+  byte valSize = PACKET_PARAM_VAL_SIZE[query[0] - PACKET_TYPE_CONTROL[FIRST]];
+  if (valSize == 0) return;
+  Udp.beginPacket(Udp.remoteIP(), Udp.remotePort());
+  Udp.write(query[0]);
+  for (byte i = 0; i < MAX_MIRROR_PARAMS; i++) {
+    if (mirror[i].type != query[0]) continue;
+    if (len == 3 && (mirror[i].param[0] != query[1] || mirror[i].param[1] != query[2])) continue;
+    Udp.write(mirror[i].param, 2);
+    Udp.write(mirror[i].val, valSize);
+  }
+  Udp.endPacket();
+#ifdef ENABLE_EXTENDED_WEBUI
+  data.udpCnt[UDP_SENT]++;
+#endif /* ENABLE_EXTENDED_WEBUI */
+}
+
+#ifdef ENABLE_EXTENDED_WEBUI
+/**************************************************************************/
+/*!
+  @brief Sends data summary (min, max and mean of SUMMARY_FIELDS in the
+  last period) via UDP and starts a new period. Fields without values are
+  omitted, nothing is sent if there are no values.
+*/
+/**************************************************************************/
+void sendSummary() {
+  byte fields = 0;
+  for (byte i = 0; i < SUMMARY_FIELDS_CNT; i++) {
+    if (summary[i].count) fields++;
+  }
+  if (fields && ethReady) {
+    IPAddress remIp = data.config.remoteIp;
+    if (data.config.udpBroadcast) remIp = { 255, 255, 255, 255 };
+    Udp.beginPacket(remIp, data.config.udpPort + SUMMARY_PORT_OFFSET);
+    Udp.write(SUMMARY_MARKER);
+    Udp.write(summarySeq++);
+    Udp.write(data.config.summaryPeriod);
+    Udp.write(fields);
+    for (byte i = 0; i < SUMMARY_FIELDS_CNT; i++) {
+      stats_t &s = summary[i];
+      if (s.count == 0) continue;
+      int16_t mean = int16_t(s.sum / s.count);
+      Udp.write(SUMMARY_FIELDS[i].header);
+      Udp.write(SUMMARY_FIELDS[i].type);
+      Udp.write(SUMMARY_FIELDS[i].offset);
+      Udp.write(lowByte(s.count));
+      Udp.write(highByte(s.count));
+      Udp.write(highByte(s.min));  // f8.8 values in the same byte order as on the bus
+      Udp.write(lowByte(s.min));
+      Udp.write(highByte(s.max));
+      Udp.write(lowByte(s.max));
+      Udp.write(highByte(mean));
+      Udp.write(lowByte(mean));
+    }
+    Udp.endPacket();
+    data.udpCnt[UDP_SENT]++;
+  }
+  memset(summary, 0, sizeof(summary));
+}
+#endif /* ENABLE_EXTENDED_WEBUI */
+
 /**************************************************************************/
 /*!
   @brief Checks P1P2 command, checks availability of queue, stores commands
@@ -63,6 +163,53 @@ void deleteCmd() {
   }
 }
 
+/**************************************************************************/
+/*!
+  @brief Finds slot for the first command in queue in the list of deferred
+  commands: slot with the same packet type and param number, or a free slot.
+  @return Slot number, MAX_DEFERRED_CMDS if the list is full.
+*/
+/**************************************************************************/
+byte findDeferred() {
+  byte slot = MAX_DEFERRED_CMDS;
+  for (byte i = 0; i < MAX_DEFERRED_CMDS; i++) {
+    if (deferredCmds[i][0] == 0) {
+      if (slot == MAX_DEFERRED_CMDS) slot = i;
+    } else if (deferredCmds[i][1] == cmdQueue[1] && deferredCmds[i][2] == cmdQueue[2] && deferredCmds[i][3] == cmdQueue[3]) {
+      return i;
+    }
+  }
+  return slot;
+}
+
+/**************************************************************************/
+/*!
+  @brief Adds Daikin EEPROM write tokens (writeQuota per day, up to
+  writeBurst) and puts deferred commands back into queue when tokens
+  above WRITE_RESERVE are available.
+*/
+/**************************************************************************/
+void refillTokens() {
+  if (data.config.writeQuota && tokenTimer.isOver()) {
+    tokenTimer.sleep(24UL * 60UL * 60UL * 1000UL / data.config.writeQuota);
+    if (data.eepromDaikin.tokens < data.config.writeBurst) data.eepromDaikin.tokens++;
+  }
+  if (data.eepromDaikin.tokens > data.config.writeBurst) data.eepromDaikin.tokens = data.config.writeBurst;
+  byte available = (data.eepromDaikin.tokens > WRITE_RESERVE) ? data.eepromDaikin.tokens - WRITE_RESERVE : 0;
+  for (byte i = 0; i < cmdQueue.size(); i += cmdQueue[i] + 1) {
+    if (cmdQueue[i + 1] == PACKET_TYPE_LOW_PRIORITY && available) available--;  // low priority commands already in queue
+  }
+  for (byte i = 0; i < MAX_DEFERRED_CMDS && available; i++) {
+    byte cmdLen = deferredCmds[i][0];
+    if (cmdLen == 0 || cmdQueue.available() <= cmdLen) continue;
+    for (byte j = 0; j <= cmdLen; j++) {
+      cmdQueue.push(deferredCmds[i][j]);
+    }
+    deferredCmds[i][0] = 0;
+    available--;
+  }
+}
+
 /**************************************************************************/
 /*!
   @brief Checks whether the packet type has specific status.
@@ -97,3 +244,71 @@ bool setPacketStatus(const byte packetType, byte status, const bool value) {
   }
   return true;
 }
+
+#ifdef ENABLE_EXTENDED_WEBUI
+/**************************************************************************/
+/*!
+  @brief Adds command (first command in queue) written to the P1P2 bus
+  to the list of commands waiting for confirmation. Pending command with
+  the same packet type and param number is replaced (retries are kept).
+  @param cmdLen Command length.
+*/
+/**************************************************************************/
+void trackCommand(const byte cmdLen) {
+  byte slot = MAX_PENDING_CMDS;
+  for (byte i = 0; i < MAX_PENDING_CMDS; i++) {
+    if (pendingCmds[i].cmd[0] == cmdQueue[1] && pendingCmds[i].cmd[1] == cmdQueue[2] && pendingCmds[i].cmd[2] == cmdQueue[3]) {
+      slot = i;
+      break;
+    }
+  }
+  if (slot == MAX_PENDING_CMDS) {
+    slot = 0;
+    for (byte i = 0; i < MAX_PENDING_CMDS; i++) {
+      if (pendingCmds[i].cmd[0] == 0) {
+        slot = i;
+        break;
+      }
+      if (millis() - pendingCmds[i].sent > millis() - pendingCmds[slot].sent) slot = i;  // list is full, replace the oldest command
+    }
+    pendingCmds[slot].retries = 0;
+  }
+  for (byte i = 0; i < cmdLen && i < sizeof(pendingCmds[slot].cmd); i++) {
+    pendingCmds[slot].cmd[i] = cmdQueue[i + 1];  // skip the first byte in the queue (cmdLen)
+  }
+  pendingCmds[slot].len = cmdLen;
+  pendingCmds[slot].sent = millis();
+  pendingCmds[slot].seen = false;
+}
+
+/**************************************************************************/
+/*!
+  @brief Retries (puts into queue again) or fails commands which were not
+  confirmed within CONFIRM_TIMEOUT. Commands are only retried if the main
+  controller requested the param with another value since the command was
+  written. If the param was not requested at all, the outcome is unknown
+  and the command is not written again.
+*/
+/**************************************************************************/
+void expireCommands() {
+  for (byte i = 0; i < MAX_PENDING_CMDS; i++) {
+    if (pendingCmds[i].cmd[0] == 0 || millis() - pendingCmds[i].sent < CONFIRM_TIMEOUT * 1000UL) continue;
+    if (!pendingCmds[i].seen) {
+      confirmCnt[CONFIRM_UNKNOWN]++;
+      pendingCmds[i].cmd[0] = 0;
+    } else if (pendingCmds[i].retries < CONFIRM_RETRIES && controllerAddr > CONNECTING && cmdQueue.available() > pendingCmds[i].len) {
+      pendingCmds[i].retries++;
+      pendingCmds[i].sent = millis();
+      pendingCmds[i].seen = false;
+      confirmCnt[CONFIRM_RETRIED]++;
+      cmdQueue.push(pendingCmds[i].len);
+      for (byte j = 0; j < pendingCmds[i].len; j++) {
+        cmdQueue.push(pendingCmds[i].cmd[j]);
+      }
+    } else {
+      confirmCnt[CONFIRM_FAILED]++;
+      pendingCmds[i].cmd[0] = 0;
+    }
+  }
+}
+#endif /* ENABLE_EXTENDED_WEBUI */
@@ -10,6 +10,9 @@ static errorbuf_t EB[RB_SIZE];
 /**************************************************************************/
 void recvBus() {
   while (P1P2Serial.packetavailable()) {
+#if defined(ENABLE_EXTENDED_WEBUI) && defined(MEASURE_LOAD)
+    sampleLoad();
+#endif
     uint16_t delta = 0;
     errorbuf_t readError = 0;
     uint16_t nread = P1P2Serial.readpacket(RB, delta, EB, RB_SIZE, CRC_GEN, CRC_FEED);
@@ -22,6 +25,15 @@ void recvBus() {
       readError = 0xFF;
     }
     for (uint16_t i = 0; i < nread; i++) readError |= EB[i];
+#ifdef ENABLE_EXTENDED_WEBUI
+    recordHistory(nread, delta, readError);
+    checkReply(readError);
+    processTiming(nread, delta, readError);
+    if (!readError) {
+      confirmCommands(nread);
+      bootStage(BOOT_PACKET);
+    }
+#endif /* ENABLE_EXTENDED_WEBUI */
 
     if (!readError) {
       // message received, no error detected, forward to UDP and parse some info about the heat pump (name, date etc.)
@@ -31,11 +43,19 @@ void recvBus() {
       p1p2Timer.sleep(data.config.connectTimeout * 1000UL);
 
       // act as auxiliary controller:
-      if (P1P2Serial.writeready() && (controllerAddr > CONNECTING) && (RB[0] == 0x00) && (RB[1] == controllerAddr)) {
-
-        connectionTimer.sleep(data.config.connectTimeout * 1000UL);
-        //if 1) the main controller sends request to our auxiliary controller 2) we are write ready => always respond
-        processWrite(nread);
+      if ((controllerAddr > CONNECTING) && (RB[0] == 0x00) && (RB[1] == controllerAddr)) {
+#ifdef ENABLE_EXTENDED_WEBUI
+        replyCnt[REPLY_REQUESTS]++;
+#endif /* ENABLE_EXTENDED_WEBUI */
+        if (P1P2Serial.writeready()) {
+          connectionTimer.sleep(data.config.connectTimeout * 1000UL);
+          //if 1) the main controller sends request to our auxiliary controller 2) we are write ready => always respond
+          processWrite(nread);
+#ifdef ENABLE_EXTENDED_WEBUI
+        } else {
+          replyCnt[REPLY_SKIPPED]++;
+#endif /* ENABLE_EXTENDED_WEBUI */
+        }
       }
     } else {
 #ifdef ENABLE_EXTENDED_WEBUI
@@ -43,6 +63,9 @@ void recvBus() {
 #endif /* ENABLE_EXTENDED_WEBUI */
     }
   }
+#ifdef SW_SCOPE
+  if (scopeEnabled && ethReady) sendScope();
+#endif /* SW_SCOPE */
 }
 
 /**************************************************************************/
@@ -61,8 +84,17 @@ void processParseRead(uint16_t n, uint16_t delta) {
   if (setPacketStatus(RB[2], PACKET_SEEN, true) == true) {
     updateEeprom();
   }
+  bool sendRaw = true;
+#ifdef ENABLE_EXTENDED_WEBUI
+  if (data.config.summaryMode != SUMMARY_OFF) {
+    summarizeFields(n);
+    if (data.config.summaryMode == SUMMARY_ONLY && RB[2] >= PACKET_TYPE_DATA[FIRST] && RB[2] <= PACKET_TYPE_DATA[LAST]) {
+      sendRaw = false;  // data packets are replaced by the summary
+    }
+  }
+#endif /* ENABLE_EXTENDED_WEBUI */
   // Send to UDP
-  if (data.config.sendAllPackets || getPacketStatus(RB[2], PACKET_SENT) == true) {
+  if (ethReady && sendRaw && (data.config.sendAllPackets || getPacketStatus(RB[2], PACKET_SENT) == true)) {
     if (changedPacket(RB, n) == true) {
       // Send packets according to settings
       IPAddress remIp = data.config.remoteIp;
@@ -72,6 +104,7 @@ void processParseRead(uint16_t n, uint16_t delta) {
       Udp.endPacket();
 #ifdef ENABLE_EXTENDED_WEBUI
       data.udpCnt[UDP_SENT]++;
+      sendEventPacket(RB, n);
 #endif /* ENABLE_EXTENDED_WEBUI */
     }
   }
@@ -108,26 +141,37 @@ void processParseRead(uint16_t n, uint16_t delta) {
     if (daikinOutdoor[0] == '\0') daikinOutdoor[0] = '-';  // if response from heat pup is empty, write '-' in order to prevent repeated requests from us
   }
 #endif /* ENABLE_EXTENDED_WEBUI */
+#ifdef ENABLE_EXTENDED_WEBUI
+  if ((RB[0] == 0x40) && (RB[1] == 0x00) && (RB[2] == PACKET_TYPE_COUNTER)) {
+    checkCounter(n);
+  }
+#endif /* ENABLE_EXTENDED_WEBUI */
+  // mirror field settings
+  mirrorParams(n);
   // check for other auxiliary controllers and get controller address
   if (((RB[1] & 0xF0) == 0xF0) && (RB[2] >= PACKET_TYPE_HANDSHAKE && RB[2] <= 0x3F)) {
     if (RB[0] == 0x00 && RB[2] == PACKET_TYPE_HANDSHAKE) {
       // 00Fx30 request message received
       // check if there is no other auxiliary controller
+      // threshold reached (lower threshold for the last address used by this controller), no auxiliary controller answering to address 0x(RB[1], HEX)
+      if ((controllerAddr == CONNECTING)
+          && ((FxRequests[RB[1] & 0x0F]) == F0THRESHOLD || (RB[1] == data.lastAddr && (FxRequests[RB[1] & 0x0F]) >= LAST_ADDR_THRESHOLD))) {
+        controllerAddr = RB[1];
+        if (data.lastAddr != controllerAddr) {
+          data.lastAddr = controllerAddr;
+          updateEeprom();
+        }
+      }
       if ((FxRequests[RB[1] & 0x0F]) == -1) {
         FxRequests[RB[1] & 0x0F] = 1;  // skip 0 (reserved for "request not made")
       } else if ((FxRequests[RB[1] & 0x0F]) < F0THRESHOLD) {
         FxRequests[RB[1] & 0x0F]++;
-      } else if ((FxRequests[RB[1] & 0x0F]) == F0THRESHOLD) {
-        // Threshold reached, no auxiliary controller answering to address 0x(RB[1], HEX)
-        if (controllerAddr == CONNECTING) {
-          controllerAddr = RB[1];
-        }
       }
     } else if (RB[0] == 0x40) {
-      // 40Fx3x auxiliary controller reply received - note this could be our own (slow, delta=F030DELAY or F03XDELAY) reply so only reset count if delta < min(F03XDELAY, F030DELAY) (- margin)
+      // 40Fx3x auxiliary controller reply received - note this could be our own (slow, delta=replyDelay()) reply so only reset count if delta < min(replyDelay()) (- margin)
       // Note for developers using >1 P1P2Monitor-interfaces (=to self): this detection mechanism fails if there are 2 P1P2Monitor programs (and adapters) with same delay settings on the same bus.
       // check if there is any other auxiliary controller on 0x3x
-      if ((delta < F03XDELAY - 2) && (delta < F030DELAY - 2)) {
+      if ((delta < replyDelay(false) - 2) && (delta < replyDelay(true) - 2)) {
         FxRequests[RB[1] & 0x0F] = -2;
         if (RB[1] == controllerAddr) {
           // controllerAddr conflicts with auxiliary controller
@@ -147,14 +191,24 @@ void processParseRead(uint16_t n, uint16_t delta) {
 /**************************************************************************/
 void processErrors(uint16_t nread) {
   uint8_t packetErrorFlags = 0;  // 2-bit flag to store P1P2_WRITE_ERROR and P1P2_READ_ERROR
+#ifdef ENABLE_EXTENDED_WEBUI
+  bool collision = false;  // our write collided with another device
+  byte flags = 0;          // all error flags of the packet
+#endif /* ENABLE_EXTENDED_WEBUI */
 
   for (uint16_t i = 0; i < nread; i++) {
     uint8_t errors = EB[i];
+#ifdef ENABLE_EXTENDED_WEBUI
+    flags |= errors;
+#endif /* ENABLE_EXTENDED_WEBUI */
     if (errors & (ERROR_SB        // collision suspicion due to data verification error in reading back written data
                   | ERROR_BE      // collision suspicion due to data verification error in reading back written data
                   | ERROR_BC)) {  // collision suspicion due to 0 during 2nd half bit signal read back
       packetErrorFlags |= (1 << P1P2_WRITE_ERROR);
     }
+#ifdef ENABLE_EXTENDED_WEBUI
+    if (errors & (ERROR_BE | ERROR_BC)) collision = true;
+#endif /* ENABLE_EXTENDED_WEBUI */
     if (errors & (ERROR_PE         // parity error detected
                   | ERROR_OR       // buffer overrun detected (overrun is after, not before, the read byte)
                   | ERROR_CRC)) {  // CRC error detected in readpacket
@@ -163,6 +217,32 @@ void processErrors(uint16_t nread) {
   }
   if (packetErrorFlags & (1 << P1P2_WRITE_ERROR)) data.p1p2Cnt[P1P2_WRITE_ERROR]++;
   if (packetErrorFlags & (1 << P1P2_READ_ERROR)) data.p1p2Cnt[P1P2_READ_ERROR]++;
+#ifdef ENABLE_EXTENDED_WEBUI
+  if (collision) {
+    // back off adaptive reply delays
+    if (delayBackoff < 0xFF - REPLY_DELAY_BACKOFF) delayBackoff += REPLY_DELAY_BACKOFF;
+    backoffCnt = 0;
+  }
+  // packet type is only known if it was read without parity error
+  byte row = timingRow((nread > 2 && !(EB[2] & ERROR_PE)) ? RB[2] : 0);
+  for (byte i = 0; i < ERR_CLASS_LAST; i++) {
+    if ((flags & ERROR_CLASS_FLAG[i]) && errorMatrix[row][i] < 0xFFFF) errorMatrix[row][i]++;
+  }
+  // error bursts
+  uint32_t now = millis();
+  burst_t &b = bursts[burstIdx];
+  if (b.packets && now - lastErrorTime < ERROR_BURST_GAP) {
+    if (b.packets < 0xFF) b.packets++;
+    b.flags |= flags;
+  } else {
+    burstIdx = (burstIdx + 1) % ERROR_BURSTS;
+    bursts[burstIdx].start = now;
+    bursts[burstIdx].cycleOffset = (cycleStart && now - cycleStart < 0xFFFF) ? now - cycleStart : 0xFFFF;
+    bursts[burstIdx].packets = 1;
+    bursts[burstIdx].flags = flags;
+  }
+  lastErrorTime = now;
+#endif /* ENABLE_EXTENDED_WEBUI */
 }
 
 /**************************************************************************/
@@ -176,7 +256,7 @@ void processWrite(uint16_t n) {
   WB[0] = 0x40;
   WB[1] = RB[1];
   WB[2] = RB[2];
-  byte d = F03XDELAY;
+  byte d = replyDelay(false);
   byte cmdType = 0;
   byte cmdLen = 0;
   if (cmdQueue.isEmpty() == false) {
@@ -193,13 +273,24 @@ void processWrite(uint16_t n) {
   // Write command from queue
   if (cmdLen && RB[2] == cmdType) {  // second byte in queue is packet type, compare to received packet type
     if ((cmdLen + 2U) <= n) {        // check if param size in queue is not larger than space available in packet
-      if (data.eepromDaikin.today < data.config.writeQuota) {
+      byte slot = findDeferred();
+      if (data.eepromDaikin.tokens > ((cmdType == PACKET_TYPE_LOW_PRIORITY) ? WRITE_RESERVE : 0)) {
         for (byte i = 0; i < cmdLen; i++) {
           WB[i + 2] = cmdQueue[i + 1];  // skip the first byte in the queue (cmdLen)
         }
+        if (slot < MAX_DEFERRED_CMDS) deferredCmds[slot][0] = 0;  // deferred value of the same param is superseded
+        data.eepromDaikin.tokens--;
         data.eepromDaikin.total++;
         data.eepromDaikin.today++;
+#ifdef ENABLE_EXTENDED_WEBUI
+        trackCommand(cmdLen);
+#endif /* ENABLE_EXTENDED_WEBUI */
         // updateEeprom();  // is it really needed?
+      } else if (cmdType == PACKET_TYPE_LOW_PRIORITY && slot < MAX_DEFERRED_CMDS && cmdLen < sizeof(deferredCmds[slot])) {
+        // low priority command waits for write tokens, replaces deferred value of the same param
+        for (byte i = 0; i <= cmdLen; i++) {
+          deferredCmds[slot][i] = cmdQueue[i];
+        }
       } else {
         data.eepromDaikin.dropped++;
       }
@@ -212,7 +303,7 @@ void processWrite(uint16_t n) {
     switch (RB[2]) {
       case PACKET_TYPE_HANDSHAKE:  // 0x30
         {
-          d = F030DELAY;
+          d = replyDelay(true);
           WB[3] = RB[3];                              // trigger packet 0x31 if indicated in 00Fx30 request
           WB[4] = RB[4];                              // trigger packet 0x32 if indicated in 00Fx30 request
           for (byte i = 5; i < n; i++) WB[i] = 0x00;  // default response for the rest of the packet
@@ -229,24 +320,26 @@ void processWrite(uint16_t n) {
             WB[1] = 0x00;
             n = cmdLen + 2;
             if (n <= sizeof(WB)) {  // check if size in queue is not larger than space available in packet
-              for (byte i = 0; i < (cmdLen - 1); i++) {
+              for (byte i = 0; i < cmdLen; i++) {
                 WB[i + 2] = cmdQueue[i + 1];  // skip the first byte in the queue (cmdLen)
               }
             } else {
               n = sizeof(WB);
               // TODO error
             }
-            if (cmdType == PACKET_TYPE_COUNTER) {
-              if (cmdQueue[2] < 5) {
-                cmdQueue.push(cmdLen);
-                cmdQueue.push(cmdType);
-                cmdQueue.push(cmdQueue[2] + 1);
-              }
-            }
             div2 = 2;
             deleteCmd();  // delete cmd in Queue
+          } else if (counterSweep) {  // free time slot, request next counter sub-type of the sweep
+            byte sub = 0;
+            while (!(counterSweep & masks[sub])) sub++;
+            counterSweep &= ~masks[sub];
+            WB[0] = 0x00;
+            WB[1] = 0x00;
+            WB[2] = PACKET_TYPE_COUNTER;
+            WB[3] = sub;
+            n = 4;
           }
-          if (div2) {  // insert counterRequest messages and other commands at end of each 2nd cycle
+          if (div2) {  // insert queued commands at end of each 2nd cycle
             div2--;
           }
         }
@@ -282,12 +375,456 @@ void processWrite(uint16_t n) {
         break;
     }
   }
+#ifdef ENABLE_EXTENDED_WEBUI
+  scheduleReply(d);
+#endif /* ENABLE_EXTENDED_WEBUI */
   P1P2Serial.writepacket(WB, n, d, CRC_GEN, CRC_FEED);
 #ifdef ENABLE_EXTENDED_WEBUI
   data.p1p2Cnt[P1P2_WRITE_OK]++;
 #endif /* ENABLE_EXTENDED_WEBUI */
 }
 
+/**************************************************************************/
+/*!
+  @brief Gets time delay for our reply to 00Fx3x request. In adaptive mode,
+  the delay is the longest response delay of other auxiliary controllers
+  plus margin and backoff, limited by the fixed delay.
+  @param handshake Reply to 00Fx30 request.
+  @return Delay in ms.
+*/
+/**************************************************************************/
+byte replyDelay(const bool handshake) {
+  byte d = handshake ? F030DELAY : F03XDELAY;
+#ifdef ENABLE_EXTENDED_WEBUI
+  if (data.config.replyDelay == DELAY_ADAPTIVE) {
+    uint16_t adaptive = otherDelay[handshake ? 0 : 1] + REPLY_DELAY_MARGIN + delayBackoff;
+    if (adaptive < MIN_REPLY_DELAY) adaptive = MIN_REPLY_DELAY;
+    if (adaptive < d) d = adaptive;
+  }
+#endif /* ENABLE_EXTENDED_WEBUI */
+  return d;
+}
+
+#ifdef ENABLE_EXTENDED_WEBUI
+/**************************************************************************/
+/*!
+  @brief Measures how long after the request our reply is scheduled for
+  writing. The library writes the reply only if the pause on the bus is
+  still shorter than the response delay, otherwise the reply is late
+  (the slowest loop stage is recorded as the probable cause).
+  Should be called right before the reply (in WB) is written.
+  @param d Response delay in ms.
+*/
+/**************************************************************************/
+void scheduleReply(const byte d) {
+  uint16_t lag = P1P2Serial.pause_msec();
+  replyLag[lagBucket(lag)]++;
+  replyLagSum += lag;
+  if (lag >= d) {
+    replyCnt[REPLY_LATE]++;
+    replyLateStage[slowStage]++;
+  } else {
+    memcpy(replyPending, WB, sizeof(replyPending));  // reply should be the next packet read back from the bus
+  }
+}
+
+/**************************************************************************/
+/*!
+  @brief Gets log2 histogram bucket for a time in ms.
+  @param ms Time in ms.
+  @return Bucket 0 for 0 ms, 1 for 1 ms, 2 for 2-3 ms, ..., LAG_BUCKETS - 1 for >= 128 ms.
+*/
+/**************************************************************************/
+byte lagBucket(uint16_t ms) {
+  byte bucket = 0;
+  for (; ms > 0 && bucket < LAG_BUCKETS - 1; ms >>= 1) {
+    bucket++;
+  }
+  return bucket;
+}
+
+/**************************************************************************/
+/*!
+  @brief Collects bus timing statistics: response delays of other devices
+  (per packet type), duration of the data packets cycle and bus idle time.
+  Should be called for every packet read from the bus (RB).
+  @param n Bytes read.
+  @param delta Pause (ms) on the bus before the packet.
+  @param readError Read errors of the packet.
+*/
+/**************************************************************************/
+void processTiming(const uint16_t n, const uint16_t delta, const errorbuf_t readError) {
+  uint32_t now = millis();
+  busBits += n * 11UL;  // start bit, 8 data bits, parity bit, stop bit
+  if (now - busStart > BUS_WINDOW) {
+    busBits >>= 1;
+    busStart = now - ((now - busStart) >> 1);
+  }
+  if (readError) {
+    lastRequest[0] = 0xFF;
+    return;
+  }
+  if (RB[0] == 0x00) {
+    memcpy(lastRequest, RB, sizeof(lastRequest));
+    if (RB[1] == 0x00 && RB[2] == PACKET_TYPE_DATA[FIRST]) {
+      if (cycleStart && now - cycleStart < 0xFFFF) {
+        cycle[0] = now - cycleStart;
+        if (cycle[1] == 0 || cycle[0] < cycle[1]) cycle[1] = cycle[0];
+        if (cycle[0] > cycle[2]) cycle[2] = cycle[0];
+      }
+      cycleStart = now;
+    }
+    return;
+  }
+  // response to the last request, our own replies are not included (see replyLag)
+  if (lastRequest[0] == 0x00 && RB[1] == lastRequest[1] && RB[2] == lastRequest[2] && (RB[1] != controllerAddr || controllerAddr <= CONNECTING)) {
+    byte row = timingRow(RB[2]);
+    responseDelay[row][lagBucket(delta)]++;
+    responseDelaySum[row] += delta;
+    if (row == TIMING_CONTROL && (RB[1] & 0xF0) == 0xF0) {  // other auxiliary controller
+      byte i = (RB[2] == PACKET_TYPE_HANDSHAKE) ? 0 : 1;
+      if (delta > otherDelay[i]) otherDelay[i] = (delta > 0xFF) ? 0xFF : delta;
+    }
+  }
+  lastRequest[0] = 0xFF;
+}
+
+/**************************************************************************/
+/*!
+  @brief Stores packet (RB) into the packet history ring buffer, oldest
+  entries are overwritten. Entries not yet sent to the /history client are
+  never overwritten, the packet is dropped instead.
+  @param n Packet length.
+  @param delta Pause (ms) on the bus before the packet.
+  @param readError Read errors of the packet.
+*/
+/**************************************************************************/
+void recordHistory(const uint16_t n, const uint16_t delta, const errorbuf_t readError) {
+  uint32_t now = millis();
+  uint32_t dt = historyCnt ? now - historyLast : 0;
+  byte size = 2 + varintSize(dt) + varintSize(delta) + n;
+  while (HISTORY_SIZE - historyUsed < size) {
+    uint16_t pos = (historyTail + 2) % HISTORY_SIZE;
+    byte oldSize = 2 + history[historyTail] + varintSize(historyVarint(pos));
+    oldSize += varintSize(historyVarint(pos));
+    if (historySocket != MAX_SOCK_NUM && (historyPos + HISTORY_SIZE - historyTail) % HISTORY_SIZE < oldSize) {
+      historyDropped++;  // entry was not sent yet
+      return;
+    }
+    historyTail = (historyTail + oldSize) % HISTORY_SIZE;
+    historyUsed -= oldSize;
+    historyCnt--;
+    if (historyCnt) {
+      pos = (historyTail + 2) % HISTORY_SIZE;
+      historyFirst += historyVarint(pos);
+    }
+  }
+  uint16_t pos = (historyTail + historyUsed) % HISTORY_SIZE;
+  history[pos] = n;
+  pos = (pos + 1) % HISTORY_SIZE;
+  history[pos] = byte(readError);
+  pos = (pos + 1) % HISTORY_SIZE;
+  for (byte v = 0; v < 2; v++) {
+    uint32_t val = v ? delta : dt;
+    do {
+      history[pos] = (val & 0x7F) | (val > 0x7F ? 0x80 : 0);
+      pos = (pos + 1) % HISTORY_SIZE;
+      val >>= 7;
+    } while (val);
+  }
+  for (byte i = 0; i < n; i++) {
+    history[pos] = RB[i];
+    pos = (pos + 1) % HISTORY_SIZE;
+  }
+  if (historyCnt == 0) historyFirst = now;
+  historyLast = now;
+  historyUsed += size;
+  historyCnt++;
+}
+
+/**************************************************************************/
+/*!
+  @brief Reads varint (7 bits per byte, little endian, bit 7 set if more
+  bytes follow) from the packet history ring buffer.
+  @param pos Position in history[], moved behind the varint.
+  @return Value
+*/
+/**************************************************************************/
+uint32_t historyVarint(uint16_t &pos) {
+  uint32_t val = 0;
+  for (byte shift = 0; shift < 32; shift += 7) {
+    byte b = history[pos];
+    pos = (pos + 1) % HISTORY_SIZE;
+    val |= uint32_t(b & 0x7F) << shift;
+    if (!(b & 0x80)) break;
+  }
+  return val;
+}
+
+/**************************************************************************/
+/*!
+  @brief Number of bytes of a varint.
+  @param val Value
+  @return Number of bytes
+*/
+/**************************************************************************/
+byte varintSize(uint32_t val) {
+  byte size = 1;
+  while (val > 0x7F) {
+    val >>= 7;
+    size++;
+  }
+  return size;
+}
+
+/**************************************************************************/
+/*!
+  @brief Row of responseDelay[] and errorMatrix[] for the packet type.
+  @param type Packet type
+  @return Row number (data packets, control packets, other).
+*/
+/**************************************************************************/
+byte timingRow(const byte type) {
+  if (type >= PACKET_TYPE_DATA[FIRST] && type <= PACKET_TYPE_DATA[LAST]) {
+    return type - PACKET_TYPE_DATA[FIRST];
+  } else if (type >= PACKET_TYPE_CONTROL[FIRST] && type <= PACKET_TYPE_CONTROL[LAST]) {
+    return TIMING_CONTROL;
+  }
+  return TIMING_OTHER;
+}
+
+/**************************************************************************/
+/*!
+  @brief Calculates bus idle time from bits transmitted on the bus
+  since busStart.
+  @return Bus idle time in %.
+*/
+/**************************************************************************/
+byte busIdle() {
+  uint32_t elapsed = millis() - busStart;
+  if (elapsed == 0) return 100;
+  uint32_t busy = busBits * 125UL / (elapsed * 12UL);  // bits / 9600 baud / elapsed seconds * 100 %
+  if (busy > 100) busy = 100;
+  return 100 - busy;
+}
+
+#ifdef ENABLE_EXTENDED_WEBUI
+/**************************************************************************/
+/*!
+  @brief Reads voltages measured by the ADC (adapters with hwID 1) since the
+  last call, updates voltage statistics and sends the voltage record via UDP.
+  P1P2 errors are counted during intervals with bus voltage sag.
+*/
+/**************************************************************************/
+void sampleVoltage() {
+  static uint32_t prevErrors = 0;
+  uint16_t vMin[ADC_LAST], vMax[ADC_LAST];
+  uint32_t vAvg[ADC_LAST];
+  P1P2Serial.ADC_results(vMin[ADC_BUS], vMax[ADC_BUS], vAvg[ADC_BUS], vMin[ADC_SUPPLY], vMax[ADC_SUPPLY], vAvg[ADC_SUPPLY]);
+  uint32_t errors = data.p1p2Cnt[P1P2_READ_ERROR] + data.p1p2Cnt[P1P2_WRITE_ERROR];
+  uint32_t diff = errors - prevErrors;
+  prevErrors = errors;
+  uint16_t newErrors = (diff > 0xFFFF) ? 0xFFFF : diff;
+  if (vAvg[ADC_BUS] == 0) return;  // no results yet
+  for (byte i = 0; i < ADC_LAST; i++) {
+    voltage_t &v = voltage[i];
+    // min and max are sums of 2^ADC_AVG_SHIFT samples, avg is sum of 2^(16 - ADC_CNT_SHIFT) samples
+    v.last[0] = (uint32_t(vMin[i]) * ADC_FULL_SCALE[i]) / (1023UL << ADC_AVG_SHIFT);
+    v.last[1] = ((vAvg[i] >> (16 - ADC_CNT_SHIFT)) * ADC_FULL_SCALE[i]) / 1023UL;
+    v.last[2] = (uint32_t(vMax[i]) * ADC_FULL_SCALE[i]) / (1023UL << ADC_AVG_SHIFT);
+    if (v.min == 0 || v.last[0] < v.min) v.min = v.last[0];
+    if (v.last[2] > v.max) v.max = v.last[2];
+  }
+  if (voltage[ADC_BUS].last[0] < BUS_VOLTAGE_LOW) {
+    sagCnt++;
+    sagErrors += newErrors;
+  }
+  if (!ethReady) return;
+  IPAddress remIp = data.config.remoteIp;
+  if (data.config.udpBroadcast) remIp = { 255, 255, 255, 255 };
+  Udp.beginPacket(remIp, data.config.udpPort + VOLTAGE_PORT_OFFSET);
+  Udp.write(VOLTAGE_MARKER);
+  Udp.write(voltageSeq++);
+  Udp.write(VOLTAGE_INTERVAL);
+  for (byte i = 0; i < ADC_LAST; i++) {
+    for (byte j = 0; j < 3; j++) {
+      Udp.write(lowByte(voltage[i].last[j]));
+      Udp.write(highByte(voltage[i].last[j]));
+    }
+  }
+  Udp.write(lowByte(newErrors));
+  Udp.write(highByte(newErrors));
+  Udp.endPacket();
+  data.udpCnt[UDP_SENT]++;
+}
+#endif /* ENABLE_EXTENDED_WEBUI */
+
+#ifdef MEASURE_LOAD
+/**************************************************************************/
+/*!
+  @brief Collects ISR load of the last packet read or written (measured by
+  the P1P2Serial library) into rolling statistics.
+*/
+/**************************************************************************/
+void sampleLoad() {
+  uint16_t isr[LOAD_LAST];
+  uint16_t lapsed[LOAD_LAST];
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    isr[LOAD_READ] = irq_r;
+    isr[LOAD_WRITE] = irq_w;
+    lapsed[LOAD_READ] = irq_lapsed_r;
+    lapsed[LOAD_WRITE] = irq_lapsed_w;
+    irq_r = 0;  // each packet is sampled only once
+    irq_w = 0;
+  }
+  for (byte i = 0; i < LOAD_LAST; i++) {
+    if (isr[i] == 0 || lapsed[i] < BIT_TIME_X10) continue;
+    uint16_t perBit = isr[i] / (lapsed[i] / BIT_TIME_X10);  // in 0.1 us
+    if (perBit > busLoad[i].peak) busLoad[i].peak = perBit;
+    busLoad[i].isr += isr[i];
+    busLoad[i].lapsed += lapsed[i];
+    if (busLoad[i].lapsed > LOAD_WINDOW) {
+      busLoad[i].isr >>= 1;
+      busLoad[i].lapsed >>= 1;
+    }
+  }
+}
+#endif /* MEASURE_LOAD */
+
+#ifdef SW_SCOPE
+/**************************************************************************/
+/*!
+  @brief Sends edge timing of the last packet logged by the P1P2Serial scope
+  as a binary UDP datagram (format is described in README).
+*/
+/**************************************************************************/
+void sendScope() {
+  byte dropped;
+  uint16_t n = P1P2Serial.scopeRead(dropped);
+  if (n == 0) return;
+  IPAddress remIp = data.config.remoteIp;
+  if (data.config.udpBroadcast) remIp = { 255, 255, 255, 255 };
+  Udp.beginPacket(remIp, data.config.udpPort + SCOPE_PORT_OFFSET);
+  Udp.write(SCOPE_MARKER);
+  Udp.write(scopeSeq++);
+  Udp.write(byte(F_CPU / 1000000UL));  // timer ticks per us
+  Udp.write(lowByte(n));               // bit 15: oldest events were lost, bits 0-14: number of events
+  Udp.write(highByte(n));
+  Udp.write(dropped);
+  n &= 0x7FFF;
+  // events are read in place from the library and written in chunks (one SPI transfer per chunk)
+  byte chunk[SCOPE_CHUNK * 3];
+  byte len = 0;
+  for (uint16_t i = 0; i < n; i++) {
+    uint16_t capture;
+    byte event = P1P2Serial.scopeEvent(i, capture);
+    chunk[len++] = lowByte(capture);
+    chunk[len++] = highByte(capture);
+    chunk[len++] = event;
+    if (len == sizeof(chunk) || i == n - 1) {
+      Udp.write(chunk, len);
+      len = 0;
+    }
+  }
+  P1P2Serial.scopeRelease();
+  Udp.endPacket();
+}
+#endif /* SW_SCOPE */
+
+/**************************************************************************/
+/*!
+  @brief Checks whether the packet read from the bus is our pending reply.
+  Should be called for every packet read from the bus (RB).
+  @param readError Read errors of the packet.
+*/
+/**************************************************************************/
+void checkReply(const errorbuf_t readError) {
+  if (replyPending[0] == 0xFF) return;
+  if (!readError && memcmp(RB, replyPending, sizeof(replyPending)) == 0) {
+    replyCnt[REPLY_ON_TIME]++;
+    if (delayBackoff && ++backoffCnt >= REPLY_DELAY_RECOVERY) {
+      delayBackoff--;
+      backoffCnt = 0;
+    }
+  } else {
+    replyCnt[REPLY_MISSED]++;
+  }
+  replyPending[0] = 0xFF;
+}
+
+/**************************************************************************/
+/*!
+  @brief Confirms pending commands whose new value appears in the 00Fx3x
+  request (RB) of the main controller, marks those whose param appears
+  with another value.
+  @param n Bytes read.
+*/
+/**************************************************************************/
+void confirmCommands(uint16_t n) {
+  if (RB[0] != 0x00 || (RB[1] & 0xF0) != 0xF0 || RB[2] < PACKET_TYPE_CONTROL[FIRST] || RB[2] > PACKET_TYPE_CONTROL[LAST]) return;
+  byte valSize = PACKET_PARAM_VAL_SIZE[RB[2] - PACKET_TYPE_CONTROL[FIRST]];
+  if (valSize == 0) return;
+  if (CRC_GEN) n--;  // omit CRC
+  for (byte i = 0; i < MAX_PENDING_CMDS; i++) {
+    if (pendingCmds[i].cmd[0] != RB[2]) continue;
+    // payload is a list of params: param number (2 bytes) and param value (valSize bytes)
+    for (uint16_t j = 3; j + 2 + valSize <= n; j += 2 + valSize) {
+      if (RB[j] != pendingCmds[i].cmd[1] || RB[j + 1] != pendingCmds[i].cmd[2]) continue;
+      if (memcmp(&RB[j + 2], &pendingCmds[i].cmd[3], valSize) == 0) {
+        confirmTime[0] = millis() - pendingCmds[i].sent;
+        if (confirmCnt[CONFIRM_OK] == 0 || confirmTime[0] < confirmTime[1]) confirmTime[1] = confirmTime[0];
+        if (confirmTime[0] > confirmTime[2]) confirmTime[2] = confirmTime[0];
+        confirmCnt[CONFIRM_OK]++;
+        pendingCmds[i].cmd[0] = 0;
+      } else {
+        pendingCmds[i].seen = true;
+      }
+      break;
+    }
+  }
+}
+#endif /* ENABLE_EXTENDED_WEBUI */
+
+#ifdef ENABLE_EXTENDED_WEBUI
+/**************************************************************************/
+/*!
+  @brief Adds values of SUMMARY_FIELDS found in the packet to the data summary.
+  @param n Packet length (without CRC).
+*/
+/**************************************************************************/
+void summarizeFields(const uint16_t n) {
+  for (byte i = 0; i < SUMMARY_FIELDS_CNT; i++) {
+    if (RB[0] != SUMMARY_FIELDS[i].header || RB[2] != SUMMARY_FIELDS[i].type || 3U + SUMMARY_FIELDS[i].offset + 1 >= n) continue;
+    int16_t val = int16_t((RB[3 + SUMMARY_FIELDS[i].offset] << 8) | RB[4 + SUMMARY_FIELDS[i].offset]);
+    stats_t &s = summary[i];
+    if (s.count == 0 || val < s.min) s.min = val;
+    if (s.count == 0 || val > s.max) s.max = val;
+    s.sum += val;
+    if (s.count < 0xFFFF) s.count++;
+  }
+}
+
+/**************************************************************************/
+/*!
+  @brief Compares 40000B8 counter response with the previous response of
+  the same sub-type. Sub-types which do not change in COUNTER_STATIC_SWEEPS
+  consecutive sweeps are skipped in regular sweeps.
+  @param n Packet length (without CRC).
+*/
+/**************************************************************************/
+void checkCounter(const uint16_t n) {
+  byte sub = RB[3];
+  if (sub >= COUNTER_SUBTYPES) return;
+  uint16_t hash = crcBytes(0xFFFF, RB + 4, n - 4);
+  if (hash == counterHash[sub]) {
+    if (counterSame[sub] < COUNTER_STATIC_SWEEPS) counterSame[sub]++;
+  } else {
+    counterHash[sub] = hash;
+    counterSame[sub] = 0;
+  }
+}
+#endif /* ENABLE_EXTENDED_WEBUI */
+
 /**************************************************************************/
 /*!
   @brief Checks whether the packet payload (received via P1P2) has changed
@@ -302,26 +839,40 @@ bool changedPacket(byte packet[], const byte packetLen) {
   bool newPacket = false;
   byte pts = (packet[0] >> 6) & 0x01;
   byte pti = packet[2] - PACKET_TYPE_DATA[FIRST];
-  byte bytestart = 0;
+  if (data.config.sendDataPackets == DATA_ALWAYS) {
+    return true;
+  } else if (packet[2] < PACKET_TYPE_DATA[FIRST] || packet[2] > PACKET_TYPE_DATA[LAST]) {
+#ifdef ENABLE_EXTENDED_WEBUI
+    return changedCachedPacket(packet, packetLen);
+#else
+    return true;  // limited SRAM, no cache for other packets
+#endif /* ENABLE_EXTENDED_WEBUI */
+  }
+  byte payloadLen = packetLen - 3;
+#ifdef ENABLE_EXTENDED_WEBUI
+  // learn payload size from the first packet of each type, or from a longer packet
+  if (payloadLen != payloadSize[pts][pti] && (!(learnedSizes[pts] & masks[pti]) || payloadLen > payloadSize[pts][pti])) {
+    payloadSize[pts][pti] = payloadLen;
+    clearSavedPackets();  // layout of saved packets has changed
+  }
+  learnedSizes[pts] |= masks[pti];
+  const byte(&sizes)[2][DATA_PACKETS_CNT] = payloadSize;
+#else
+  const byte(&sizes)[2][DATA_PACKETS_CNT] = PACKET_PAYLOAD_SIZE;  // limited SRAM, payload sizes are not learned
+#endif /* ENABLE_EXTENDED_WEBUI */
+  uint16_t bytestart = 0;
   for (byte i = 0; i <= pts; i++) {
-    for (byte j = 0; j < (PACKET_TYPE_DATA[LAST] - PACKET_TYPE_DATA[FIRST] + 1); j++) {
+    for (byte j = 0; j < DATA_PACKETS_CNT; j++) {
       if (i == pts && j == pti) break;
-      bytestart += PACKET_PAYLOAD_SIZE[i][j];
+      bytestart += sizes[i][j];
     }
   }
-  if (packet[2] < PACKET_TYPE_DATA[FIRST] || packet[2] > PACKET_TYPE_DATA[LAST] || data.config.sendDataPackets == DATA_ALWAYS) {
-    newPacket = true;
-  } else if (packetLen - 3 > PACKET_PAYLOAD_SIZE[pts][pti]) {
-    // Warning: packet longer than expected
+  if (payloadLen > sizes[pts][pti] || bytestart + payloadLen > SAVED_PACKETS_SIZE) {
+    // Warning: packet longer than expected or layout does not fit into savedPackets
     newPacket = true;
   } else {
-    for (byte i = 0; i < packetLen - 3; i++) {
+    for (byte i = 0; i < payloadLen; i++) {
       byte pi2 = bytestart + i;
-      if (pi2 >= SAVED_PACKETS_SIZE) {
-        pi2 = 0;
-        // Warning: pi2 > SAVED_PACKETS_SIZE
-        return 0;
-      }
       // this byte or at least some bits have been seen and saved before.
       if (savedPackets[pi2] != packet[i + 3]) {
         newPacket = true;
@@ -332,32 +883,205 @@ bool changedPacket(byte packet[], const byte packetLen) {
   return newPacket;
 }
 
+#ifdef ENABLE_EXTENDED_WEBUI
+/**************************************************************************/
+/*!
+  @brief Checks whether the payload of other (non-data) packet has changed
+  since the same packet (header and sub-type) was last seen. Payload hashes
+  are stored in a small cache, least recently used packet is evicted.
+  @param packet Packet
+  @param packetLen Packet length
+  @return True if a packet is not in the cache or if its payload has changed.
+*/
+/**************************************************************************/
+bool changedCachedPacket(const byte packet[], const byte packetLen) {
+  byte key[4] = { packet[0], packet[1], packet[2], 0 };
+  byte start = 3;
+  if (packet[2] >= PACKET_TYPE_SUBTYPE && packetLen > 3) {
+    key[3] = packet[3];
+    start = 4;
+  }
+  uint16_t hash = crcBytes(_crc_ccitt_update(0xFFFF, packetLen), packet + start, packetLen - start);
+  if (++cacheClock == 0) {  // clock rolled over, keep relative order of stamps
+    for (byte i = 0; i < PACKET_CACHE_SIZE; i++) {
+      if (packetCache[i].stamp) packetCache[i].stamp = (packetCache[i].stamp >> 1) | 1;
+    }
+    cacheClock = 0x81;
+  }
+  byte oldest = 0;
+  for (byte i = 0; i < PACKET_CACHE_SIZE; i++) {
+    if (packetCache[i].stamp && memcmp(packetCache[i].key, key, sizeof(key)) == 0) {
+      packetCache[i].stamp = cacheClock;
+      if (packetCache[i].hash == hash) return false;
+      packetCache[i].hash = hash;
+      return true;
+    }
+    if (packetCache[i].stamp < packetCache[oldest].stamp) oldest = i;
+  }
+  memcpy(packetCache[oldest].key, key, sizeof(key));
+  packetCache[oldest].stamp = cacheClock;
+  packetCache[oldest].hash = hash;
+  return true;
+}
+#endif /* ENABLE_EXTENDED_WEBUI */
+
+/**************************************************************************/
+/*!
+  @brief Calculates CRC16 (CCITT) of bytes.
+  @param crc Initial CRC value
+  @param buf Bytes
+  @param len Number of bytes
+  @return CRC
+*/
+/**************************************************************************/
+uint16_t crcBytes(uint16_t crc, const byte buf[], const byte len) {
+  for (byte i = 0; i < len; i++) {
+    crc = _crc_ccitt_update(crc, buf[i]);
+  }
+  return crc;
+}
+
+/**************************************************************************/
+/*!
+  @brief Forgets all saved packets, so that all packets are sent via UDP
+  when they are seen next time.
+*/
+/**************************************************************************/
+void clearSavedPackets() {
+  memset(savedPackets, 0xFF, sizeof(savedPackets));
+#ifdef ENABLE_EXTENDED_WEBUI
+  memset(packetCache, 0, sizeof(packetCache));
+#endif /* ENABLE_EXTENDED_WEBUI */
+}
+
 /**************************************************************************/
 /*!
   @brief Checks whether the parameter 36 value in the command (received
-  via UDP or web interface) changed (more than hysteresis), new value is saved.
+  via UDP or web interface) differs (more than hysteresis) from the last
+  commanded value which is not confirmed on the bus yet, or from the value
+  mirrored from the bus. The mirror is only updated from the bus.
   @param cmd Command received via UDP or web interface
-  @return True if a parameter is received from UDP for the first time
+  @return True if the current value is not known yet
   or if change in param value is greater than hysteresis.
 */
 /**************************************************************************/
 bool changed36Param(byte cmd[]) {
-  bool newVal = false;
-  if (cmd[0] != 0x36) {
-    newVal = true;
-  } else if (cmd[2] != 0 || cmd[1] > MAX_36_PARAMS) {
-    // TODO Warning: param number is higher than max allowed
-    newVal = false;
-  } else {
-    byte paramNum = cmd[1];
-    int16_t paramVal = (cmd[4] << 8) | cmd[3];
-    int16_t storedVal = (saved36Params[paramNum][1] << 8) | saved36Params[paramNum][0];
-    // this byte or at least some bits have been seen and saved before.
-    if (abs(int16_t(storedVal - paramVal)) >= int16_t(data.config.hysteresis)) {
-      newVal = true;
-      saved36Params[paramNum][0] = cmd[3];
-      saved36Params[paramNum][1] = cmd[4];
+  if (cmd[0] != 0x36) return true;
+  if (cmd[2] != 0 || cmd[1] > MAX_36_PARAMS) {
+    data.eepromDaikin.invalid++;  // Write Command Invalid (param number is higher than max allowed)
+    return false;
+  }
+  int16_t storedVal;
+  if (!commandedValue(cmd, storedVal)) {
+    byte i = findParam(cmd[0], cmd[1], cmd[2]);
+    if (i == MAX_MIRROR_PARAMS) return true;
+    storedVal = (mirror[i].val[1] << 8) | mirror[i].val[0];
+  }
+  int16_t paramVal = (cmd[4] << 8) | cmd[3];
+  return (abs(int16_t(storedVal - paramVal)) >= int16_t(data.config.hysteresis));
+}
+
+/**************************************************************************/
+/*!
+  @brief Finds the last value commanded for the param (2-byte value) which
+  is not confirmed on the bus yet: newest command in queue, deferred command
+  or written command waiting for confirmation.
+  @param cmd Command (packet type, param number, param value).
+  @param val Commanded value.
+  @return True if such command was found.
+*/
+/**************************************************************************/
+bool commandedValue(const byte cmd[], int16_t &val) {
+  const byte len = 1 + 2 + 2;  // packet type, param number, param value
+  bool found = false;
+  for (byte i = 0; i < cmdQueue.size(); i += cmdQueue[i] + 1) {
+    if (cmdQueue[i] == len && cmdQueue[i + 1] == cmd[0] && cmdQueue[i + 2] == cmd[1] && cmdQueue[i + 3] == cmd[2]) {
+      val = (cmdQueue[i + 5] << 8) | cmdQueue[i + 4];
+      found = true;  // later commands in queue are newer
     }
   }
-  return newVal;
+  if (found) return true;
+  for (byte i = 0; i < MAX_DEFERRED_CMDS; i++) {
+    if (deferredCmds[i][0] == len && deferredCmds[i][1] == cmd[0] && deferredCmds[i][2] == cmd[1] && deferredCmds[i][3] == cmd[2]) {
+      val = (deferredCmds[i][5] << 8) | deferredCmds[i][4];
+      return true;
+    }
+  }
+#ifdef ENABLE_EXTENDED_WEBUI
+  for (byte i = 0; i < MAX_PENDING_CMDS; i++) {
+    if (pendingCmds[i].len == len && pendingCmds[i].cmd[0] == cmd[0] && pendingCmds[i].cmd[1] == cmd[1] && pendingCmds[i].cmd[2] == cmd[2]) {
+      val = (pendingCmds[i].cmd[4] << 8) | pendingCmds[i].cmd[3];
+      return true;
+    }
+  }
+#endif /* ENABLE_EXTENDED_WEBUI */
+  return false;
+}
+
+/**************************************************************************/
+/*!
+  @brief Finds param in the mirror. Slots 0 - MAX_36_PARAMS are reserved
+  for packet type 0x36 params 0x00 - MAX_36_PARAMS (slot = param number),
+  other params are stored in the remaining slots (first come).
+  @param type Packet type.
+  @param paramLo Param number (low byte).
+  @param paramHi Param number (high byte).
+  @return Index in mirror[], MAX_MIRROR_PARAMS if not found.
+*/
+/**************************************************************************/
+byte findParam(const byte type, const byte paramLo, const byte paramHi) {
+  if (type == 0x36 && paramHi == 0 && paramLo <= MAX_36_PARAMS) {
+    return (mirror[paramLo].type == 0) ? MAX_MIRROR_PARAMS : paramLo;
+  }
+  byte i = MAX_36_PARAMS + 1;
+  for (; i < MAX_MIRROR_PARAMS; i++) {
+    if (mirror[i].type == 0) return MAX_MIRROR_PARAMS;  // remaining slots are filled in order
+    if (mirror[i].type == type && mirror[i].param[0] == paramLo && mirror[i].param[1] == paramHi) break;
+  }
+  return i;
+}
+
+/**************************************************************************/
+/*!
+  @brief Saves param value to the mirror (new params are ignored if the mirror is full).
+  @param type Packet type.
+  @param param Param number (2 bytes) followed by param value, as on the bus.
+*/
+/**************************************************************************/
+void saveParam(const byte type, const byte param[]) {
+  byte i = findParam(type, param[0], param[1]);
+  if (i == MAX_MIRROR_PARAMS) {
+    if (type == 0x36 && param[1] == 0 && param[0] <= MAX_36_PARAMS) {
+      i = param[0];  // reserved slot
+    } else {
+      for (i = MAX_36_PARAMS + 1; i < MAX_MIRROR_PARAMS; i++) {
+        if (mirror[i].type == 0) break;
+      }
+      if (i == MAX_MIRROR_PARAMS) return;  // mirror is full
+    }
+    mirror[i].type = type;
+    mirror[i].param[0] = param[0];
+    mirror[i].param[1] = param[1];
+  }
+  memcpy(mirror[i].val, &param[2], PACKET_PARAM_VAL_SIZE[type - PACKET_TYPE_CONTROL[FIRST]]);
+}
+
+/**************************************************************************/
+/*!
+  @brief Mirrors all params in 00Fx35 - 00Fx3D request (RB) of the main controller.
+  @param n Bytes read (without CRC).
+*/
+/**************************************************************************/
+void mirrorParams(const uint16_t n) {
+  if (RB[0] != 0x00 || (RB[1] & 0xF0) != 0xF0 || RB[2] < PACKET_TYPE_CONTROL[FIRST] || RB[2] > PACKET_TYPE_CONTROL[LAST]) return;
+#ifndef ENABLE_EXTENDED_WEBUI
+  if (RB[2] != 0x36) return;  // limited SRAM, only params needed for hysteresis
+#endif /* ENABLE_EXTENDED_WEBUI */
+  byte valSize = PACKET_PARAM_VAL_SIZE[RB[2] - PACKET_TYPE_CONTROL[FIRST]];
+  if (valSize == 0 || valSize > sizeof(mirror[0].val)) return;
+  // payload is a list of params: param number (2 bytes) and param value (valSize bytes)
+  for (byte i = 3; i + 2 + valSize <= n; i += 2 + valSize) {
+    if (RB[i] == 0xFF && RB[i + 1] == 0xFF) break;  // no more params in this packet
+    saveParam(RB[2], &RB[i]);
+  }
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 const byte URI_SIZE = 24;   // a smaller buffer for uri
 const byte POST_SIZE = 24;  // a smaller buffer for single post parameter + key
+const byte LINE_SIZE = 40;  // buffer for the beginning of a header line
 
 // Actions that need to be taken after saving configuration.
 enum action_type : byte {
@@ -13,7 +14,9 @@ enum action_type : byte {
   ACT_CONNECT,       // Connect Controller
   ACT_DISCONNECT,    // Disconnect Controller
   ACT_CLEAR_QUOTA,   // Clear Daikin EEPROM Writes Daily Quota
-  ACT_WEB            // Restart webserver
+  ACT_WEB,           // Restart webserver
+  ACT_RESET_LATENCY, // Reset loop latency profiler
+  ACT_SCOPE          // Start or stop bus scope
 };
 enum action_type action;
 
@@ -29,8 +32,17 @@ enum page : byte {
   PAGE_P1P2,
   PAGE_FILTER,
   PAGE_TOOLS,
-  PAGE_WAIT,  // page with "Reloading. Please wait..." message.
-  PAGE_DATA,  // d.json
+  PAGE_WAIT,          // page with "Reloading. Please wait..." message.
+  PAGE_DATA,          // d.json
+  PAGE_CSS,           // s.css
+  PAGE_JS,            // s.js
+  PAGE_NOT_MODIFIED,  // 304 response to s.css or s.js already cached by the browser
+#ifdef ENABLE_EXTENDED_WEBUI
+  PAGE_EVENTS,   // events (Server-Sent Events stream)
+  PAGE_METRICS,  // metrics (Prometheus text format)
+  PAGE_PARAMS,   // params (field settings mirrored from the bus, text format)
+  PAGE_HISTORY,  // history (packet history, binary or hex)
+#endif          /* ENABLE_EXTENDED_WEBUI */
 };
 
 // Keys for POST parameters, used in web forms and processed by processPost() function.
@@ -72,9 +84,13 @@ enum post_key : byte {
   POST_SEND_ALL,        // send all packets
   POST_COUNTER_PERIOD,  // period for counter requests
   POST_DATA_PACKETS,    // save data packets (send only if payload changed)
+  POST_SUMMARY_MODE,    // data summary mode
+  POST_SUMMARY_PERIOD,  // data summary period
   POST_TIMEOUT,         // connection timeout
   POST_QUOTA,           // write throttle
+  POST_BURST,           // write burst
   POST_HYSTERESIS,      // temp setpoint hysteresis
+  POST_REPLY_DELAY,     // reply delay mode
   POST_CMD_TYPE,        // write command packet type
   POST_CMD_PARAM_1,     // write command parameter number
   POST_CMD_PARAM_2,     // write command parameter number
@@ -101,6 +117,12 @@ enum JSON_type : byte {
   JSON_UDP_STATS,           // Multiple P1P2 Write Statistics
   JSON_CONTROLLER,          // Controller Mode
   JSON_OTHER_CONTROLLERS,   // Other controllers connected
+  JSON_REPLIES,             // Replies to requests addressed to this controller
+  JSON_BUS_TIMING,          // Bus cycle, idle time and response delays
+  JSON_CONFIRM,             // Confirmation of written commands
+  JSON_VOLTAGE,             // Bus and supply voltage
+  JSON_LATENCY,             // Loop latency profiler (diagnostics below this key are not pushed to the event stream)
+  JSON_ERRORS,              // P1P2 errors by packet type and error class, error bursts
   JSON_LAST,                // Must be the very last element in this array
 };
 
@@ -111,6 +133,10 @@ enum JSON_type : byte {
   should are numbered (1.htm, 2.htm, ...), the page number is passed to 
   the @ref sendPage() function. Also executes actions (such as ethernet restart,
   reboot) during "please wait" web page.
+  Connections are persistent (HTTP/1.1 keep-alive). Only one request is processed
+  per call, POST body is read according to Content-Length, so that pipelined
+  requests remain in the socket buffer and are processed during next call.
+  Only called once the whole request is in the socket buffer (see webRequestReady()).
   @param client Ethernet TCP client.
 */
 /**************************************************************************/
@@ -127,15 +153,29 @@ void recvWeb(EthernetClient &client) {
     uri[len] = c;
     len++;
   }
-  while (client.available()) {
-    if (client.read() == '\r')
-      if (client.read() == '\n')
-        if (client.read() == '\r')
-          if (client.read() == '\n')
-            break;  // find 2 end of lines between header and body
+  char line[LINE_SIZE];  // beginning of the header line, rest of the line is ignored
+  readLine(client, line, sizeof(line));
+  bool keepAlive = (strcmp(line, "HTTP/1.0") != 0);  // HTTP/1.0 closes connection by default
+  uint16_t contentLength = 0;
+  bool cached = false;  // browser has the current version of the requested asset
+  while (readLine(client, line, sizeof(line))) {  // empty line between header and body
+    if (strncasecmp(line, "Content-Length:", 15) == 0) {
+      contentLength = atol(line + 15);
+    } else if (strncasecmp(line, "If-None-Match:", 14) == 0) {
+      char *etag = strchr(line + 14, '"');  // ETag is the firmware version, for example "4.1"
+      if (etag) {
+        char *dot = strchr(etag, '.');
+        cached = (dot && atoi(etag + 1) == VERSION[0] && atoi(dot + 1) == VERSION[1]);
+      }
+    } else if (strncasecmp(line, "Connection:", 11) == 0) {
+      // comma separated list of tokens, for example "Connection: keep-alive, close"
+      for (char *token = strtok(line + 11, " \t,"); token; token = strtok(NULL, " \t,")) {
+        if (strcasecmp(token, "close") == 0) keepAlive = false;
+      }
+    }
   }
-  if (client.available()) {
-    processPost(client);  // parse post parameters
+  if (contentLength) {
+    processPost(client, contentLength);  // parse post parameters
   }
 
   // Get the requested page from URI
@@ -148,6 +188,22 @@ void recvWeb(EthernetClient &client) {
       if (reqPage > PAGE_WAIT) reqPage = PAGE_ERROR;
     } else if (strcmp(uri, "/d.json") == 0) {
       reqPage = PAGE_DATA;
+    } else if (strcmp(uri, "/s.css") == 0) {
+      reqPage = cached ? PAGE_NOT_MODIFIED : PAGE_CSS;
+    } else if (strcmp(uri, "/s.js") == 0) {
+      reqPage = cached ? PAGE_NOT_MODIFIED : PAGE_JS;
+#ifdef ENABLE_EXTENDED_WEBUI
+    } else if (strncmp(uri, "/events", 7) == 0) {
+      reqPage = PAGE_EVENTS;
+      eventPackets = (strcmp(uri + 7, "?p") == 0);  // "/events?p" also streams P1P2 packets
+    } else if (strcmp(uri, "/metrics") == 0) {
+      reqPage = PAGE_METRICS;
+    } else if (strcmp(uri, "/params") == 0) {
+      reqPage = PAGE_PARAMS;
+    } else if (strncmp(uri, "/history", 8) == 0) {
+      reqPage = PAGE_HISTORY;
+      historyHex = (strcmp(uri + 8, "?hex") == 0);  // "/history?hex" is hex encoded
+#endif /* ENABLE_EXTENDED_WEBUI */
     }
   }
   // Actions that require "please wait" page
@@ -157,11 +213,39 @@ void recvWeb(EthernetClient &client) {
   // Send page
   sendPage(client, reqPage);
 
+#ifdef ENABLE_EXTENDED_WEBUI
+  if (reqPage == PAGE_EVENTS) {
+    // only one event stream at a time, the new one replaces the old one
+    if (eventSocket != MAX_SOCK_NUM && eventSocket != client.getSocketNumber()) disconSocket(eventSocket);
+    eventSocket = client.getSocketNumber();
+    eventRefresh = true;
+    eventTimer.sleep(0);
+  } else if (reqPage == PAGE_HISTORY) {
+    // only one download at a time, the new one replaces the old one, download is closed by manageHistory()
+    if (historySocket != MAX_SOCK_NUM && historySocket != client.getSocketNumber()) disconSocket(historySocket);
+    historySocket = client.getSocketNumber();
+    historyPos = historyTail;
+    historyLeft = historyUsed;
+    keepAlive = true;  // connection is closed when the download is complete
+  }
+#endif /* ENABLE_EXTENDED_WEBUI */
+
+  if (keepAlive == false) disconSocket(client.getSocketNumber());
+
   // Do all actions before the "please wait" redirects (5s delay at the moment)
   if (reqPage == PAGE_WAIT) {
-    delay(500);  // wait for the wait page to load
+    delay(500);          // wait for the wait page to load
+    timeNow = millis();  // timers armed below must not lose the blocked time
     switch (action) {
       case ACT_WEB:
+        {
+          // only the web server moves to the new port, UDP keeps running
+          for (byte s = 0; s < maxSockNum; s++) {
+            if (W5100.readSnSR(s) != SnSR::UDP) disconSocket(s);  // all TCP sockets belong to the web server
+          }
+          webServer = EthernetServer(data.config.webPort);  // listening socket is opened by manageSockets()
+        }
+        break;
       case ACT_MAC:
       case ACT_RESET_ETH:
         for (byte s = 0; s < maxSockNum; s++) {
@@ -181,22 +265,119 @@ void recvWeb(EthernetClient &client) {
   action = ACT_NONE;
 }
 
+#ifdef ENABLE_EXTENDED_WEBUI
+/**************************************************************************/
+/*!
+  @brief Maintains the Server-Sent Events stream. Periodically pushes
+  changed status values, closes the stream if the client disconnected.
+  Called from @ref manageSockets() within SPI transaction.
+*/
+/**************************************************************************/
+void manageEvents() {
+  if (eventSocket == MAX_SOCK_NUM || eventTimer.isOver() == false) return;
+  eventTimer.sleep(EVENT_INTERVAL);
+  if (W5100.readSnSR(eventSocket) != SnSR::ESTABLISHED) {
+    eventSocket = MAX_SOCK_NUM;
+    return;
+  }
+  EthernetClient client = EthernetClient(eventSocket);
+  if (client.availableForWrite() < EVENT_MIN_FREE) return;  // client does not read, try next time
+  sendEvents(client);
+}
+
+/**************************************************************************/
+/*!
+  @brief Sends next part of the packet history to the /history client,
+  closes the connection when the download is complete. Only sends as much
+  as fits into the socket TX buffer, so that the P1P2 bus is never blocked.
+  Called from @ref manageSockets() within SPI transaction.
+*/
+/**************************************************************************/
+void manageHistory() {
+  if (historySocket == MAX_SOCK_NUM) return;
+  if (W5100.readSnSR(historySocket) != SnSR::ESTABLISHED) {
+    historySocket = MAX_SOCK_NUM;
+    return;
+  }
+  EthernetClient client = EthernetClient(historySocket);
+  if (historyLeft == 0) {
+    if (historyHex) client.print(F("\n"));
+    disconSocket(historySocket);
+    historySocket = MAX_SOCK_NUM;
+    return;
+  }
+  byte buf[HISTORY_CHUNK];
+  byte len = historyHex ? HISTORY_CHUNK / 2 : HISTORY_CHUNK;
+  if (len > historyLeft) len = historyLeft;
+  if (client.availableForWrite() < HISTORY_CHUNK) return;  // client does not read, try next time
+  for (byte i = 0; i < len; i++) {
+    byte b = history[historyPos];
+    historyPos = (historyPos + 1) % HISTORY_SIZE;
+    if (historyHex) {
+      buf[i * 2] = "0123456789ABCDEF"[b >> 4];
+      buf[i * 2 + 1] = "0123456789ABCDEF"[b & 0x0F];
+    } else {
+      buf[i] = b;
+    }
+  }
+  historyLeft -= len;
+  client.write(buf, historyHex ? len * 2 : len);
+}
+#endif /* ENABLE_EXTENDED_WEBUI */
+
+/**************************************************************************/
+/*!
+  @brief Reads one line of the HTTP header, stores beginning of the line
+  (the rest of the line is discarded).
+  @param client Ethernet TCP client.
+  @param line Buffer for the line (null terminated, without CR LF).
+  @param size Size of the buffer.
+  @return False for empty line (or if no data available).
+*/
+/**************************************************************************/
+bool readLine(EthernetClient &client, char line[], const byte size) {
+  byte len = 0;
+  bool empty = true;
+  while (client.available()) {
+    char c = client.read();
+    if (c == '\n') break;
+    if (c == '\r') continue;
+    empty = false;
+    if (len < size - 1) {
+      line[len] = c;
+      len++;
+    }
+  }
+  line[len] = '\0';
+  return !empty;
+}
+
 /**************************************************************************/
 /*!
   @brief Processes POST data from forms and buttons, updates data.config (in RAM)
   and saves config into EEPROM. Executes actions which do not require webserver restart
   @param client Ethernet TCP client.
+  @param contentLength Length of the POST body (from the Content-Length header).
 */
 /**************************************************************************/
-void processPost(EthernetClient &client) {
+void processPost(EthernetClient &client, uint16_t contentLength) {
   byte command[1 + 2 + MAX_PARAM_SIZE];  // 1 byte packet type + 2 bytes param number + MAX_PARAM_SIZE bytes param value
   byte cmdLen = 0;                       // Length of the P1P2 command from WebUI
-  while (client.available()) {
+  bool ipSettings = false;               // POST from the "IP Settings" page
+  byte oldMac[6];                        // MAC and IP before the change, only changes to these require ethernet restart
+  byte oldIp[4];
+  memcpy(oldMac, data.mac, sizeof(oldMac));
+  memcpy(oldIp, data.config.ip, sizeof(oldIp));
+#ifdef ENABLE_DHCP
+  bool oldDhcp = data.config.enableDhcp;
+#endif /* ENABLE_DHCP */
+  while (contentLength && client.available()) {
     char post[POST_SIZE];
     byte len = 0;
     bool isDecimal = false;
-    while (client.available() && len < sizeof(post) - 1) {
+    while (contentLength && client.available() && len < sizeof(post) - 1) {
       char c = client.read();
+      contentLength--;
       if (c == '&') break;
       if (c == ',' || c == '.') {
         isDecimal = true;
@@ -262,9 +443,7 @@ void processPost(EthernetClient &client) {
         break;
       case POST_MAC ... POST_MAC_5:
         {
-          action = ACT_RESET_ETH;  // this RESET_ETH is triggered when the user changes anything on the "IP Settings" page.
-                                   // No need to trigger RESET_ETH for other cases (POST_SUBNET, POST_GATEWAY etc.)
-                                   // if "Randomize" button is pressed, action is set to ACT_MAC
+          ipSettings = true;  // MAC is always sent by the "IP Settings" page
           data.mac[paramKeyByte - POST_MAC] = strToByte(paramValue);
         }
         break;
@@ -317,13 +496,20 @@ void processPost(EthernetClient &client) {
       case POST_QUOTA:
         data.config.writeQuota = byte(paramValueUint);
         break;
+      case POST_BURST:
+        if (paramValueUint <= WRITE_RESERVE) paramValueUint = WRITE_RESERVE + 1;  // low priority commands need tokens above the reserve
+        data.config.writeBurst = byte(paramValueUint);
+        break;
       case POST_HYSTERESIS:
         if (isDecimal == false) paramValueUint *= 10;
         data.config.hysteresis = byte(paramValueUint);
         break;
+      case POST_REPLY_DELAY:
+        data.config.replyDelay = byte(paramValueUint);
+        break;
       case POST_SEND_ALL:
         data.config.sendAllPackets = byte(paramValueUint);
-        memset(savedPackets, 0xFF, sizeof(savedPackets));  // reset saved packets whenever some setting on "Packet Filter" page changes
+        clearSavedPackets();  // reset saved packets whenever some setting on "Packet Filter" page changes
         break;
       case POST_COUNTER_PERIOD:
         data.config.counterPeriod = byte(paramValueUint);
@@ -331,6 +517,12 @@ void processPost(EthernetClient &client) {
       case POST_DATA_PACKETS:
         data.config.sendDataPackets = byte(paramValueUint);
         break;
+      case POST_SUMMARY_MODE:
+        data.config.summaryMode = byte(paramValueUint);
+        break;
+      case POST_SUMMARY_PERIOD:
+        data.config.summaryPeriod = byte(paramValueUint);
+        break;
       case POST_ACTION:
         action = action_type(paramValueUint);
         break;
@@ -338,6 +530,23 @@ void processPost(EthernetClient &client) {
         break;
     }
   }  // while (point != NULL)
+  if (ipSettings && action == ACT_NONE) {  // if "Randomize" button is pressed, action is already set to ACT_MAC
+    bool staticIp = true;
+    if (memcmp(oldMac, data.mac, sizeof(oldMac)) != 0 || memcmp(oldIp, data.config.ip, sizeof(oldIp)) != 0) {
+      action = ACT_RESET_ETH;
+    }
+#ifdef ENABLE_DHCP
+    if (oldDhcp != data.config.enableDhcp) action = ACT_RESET_ETH;
+    staticIp = !dhcpSuccess;  // do not overwrite settings leased from DHCP
+#endif /* ENABLE_DHCP */
+    if (action == ACT_NONE && staticIp) {  // no restart needed, write settings directly to the W5x00 registers
+      Ethernet.setSubnetMask(data.config.subnet);
+      Ethernet.setGatewayIP(data.config.gateway);
+#ifdef ENABLE_DHCP
+      Ethernet.setDnsServerIP(data.config.dns);
+#endif /* ENABLE_DHCP */
+    }
+  }
   switch (action) {
     case ACT_DEFAULT:
       {
@@ -364,10 +573,22 @@ void processPost(EthernetClient &client) {
       controllerAddr = DISCONNECTED;
       break;
     case ACT_CLEAR_QUOTA:
+      data.eepromDaikin.tokens = data.config.writeBurst;
       data.eepromDaikin.today = 0;
       data.eepromDaikin.dropped = 0;
       data.eepromDaikin.invalid = 0;
       break;
+#ifdef ENABLE_EXTENDED_WEBUI
+    case ACT_RESET_LATENCY:
+      resetLatency();
+      break;
+#endif /* ENABLE_EXTENDED_WEBUI */
+#ifdef SW_SCOPE
+    case ACT_SCOPE:
+      scopeEnabled = !scopeEnabled;
+      P1P2Serial.setScope(scopeEnabled);
+      break;
+#endif /* SW_SCOPE */
     default:
       break;
   }
@@ -1,5 +1,25 @@
 const byte WEB_OUT_BUFFER_SIZE = 64;  // size of web server write buffer (used by StreamLib)
 
+#ifdef ENABLE_EXTENDED_WEBUI
+const byte EVENT_VALUE_SIZE = 32;  // JSON values up to this size are rendered only once when pushed to the event stream
+uint16_t eventHash[JSON_LAST];     // CRC of JSON values last pushed to the event stream
+
+// Print which does not print anything, only calculates CRC of the printed data
+// and keeps the first EVENT_VALUE_SIZE bytes, so that short values need not be printed again
+class CrcPrint : public Print {
+public:
+  uint16_t crc = 0xFFFF;
+  uint16_t len = 0;
+  char value[EVENT_VALUE_SIZE + 1] = {};  // null terminated
+  size_t write(uint8_t c) {
+    crc = _crc_ccitt_update(crc, c);
+    if (len < EVENT_VALUE_SIZE) value[len] = c;
+    len++;
+    return 1;
+  }
+};
+#endif /* ENABLE_EXTENDED_WEBUI */
+
 /**************************************************************************/
 /*!
   @brief Handles HTTP responses by sending the requested web page.
@@ -43,6 +63,85 @@ void sendPage(EthernetClient &client, byte reqPage) {
     chunked.print(F("}"));
     chunked.end();
     return;
+#ifdef ENABLE_EXTENDED_WEBUI
+  } else if (reqPage == PAGE_EVENTS) {
+    chunked.print(F("HTTP/1.1 200 OK\r\n"  // no content length, the stream ends when the connection is closed
+                    "Content-Type: text/event-stream\r\n"
+                    "Cache-Control: no-cache\r\n"
+                    "\r\n"));
+    chunked.flush();
+    return;
+  } else if (reqPage == PAGE_METRICS) {
+    chunked.print(F("HTTP/1.1 200 OK\r\n"
+                    "Content-Type: text/plain; version=0.0.4\r\n"
+                    "Transfer-Encoding: chunked\r\n"
+                    "\r\n"));
+    chunked.begin();
+    sendMetrics(chunked);
+    chunked.end();
+    return;
+  } else if (reqPage == PAGE_HISTORY) {
+    chunked.print(F("HTTP/1.1 200 OK\r\n"  // no content length, the download ends when the connection is closed
+                    "Content-Type: "));
+    if (historyHex) chunked.print(F("text/plain"));
+    else chunked.print(F("application/octet-stream"));
+    chunked.print(F("\r\n"
+                    "Connection: close\r\n"
+                    "\r\n"));
+    // header: marker, millis() now, millis() of the oldest entry, number of entries, packets dropped during downloads (all little endian)
+    uint32_t header[] = { millis(), historyFirst, uint32_t(historyCnt) | (uint32_t(historyDropped) << 16) };
+    byte *b = (byte *)header;
+    chunked.print(historyHex ? F("48") : F("H"));
+    for (byte i = 0; i < sizeof(header); i++) {
+      if (historyHex) {
+        if (b[i] < 0x10) chunked.print(F("0"));
+        chunked.print(b[i], HEX);
+      } else {
+        chunked.write(b[i]);
+      }
+    }
+    chunked.flush();
+    return;
+  } else if (reqPage == PAGE_PARAMS) {
+    chunked.print(F("HTTP/1.1 200 OK\r\n"
+                    "Content-Type: text/plain\r\n"
+                    "Transfer-Encoding: chunked\r\n"
+                    "\r\n"));
+    chunked.begin();
+    sendParamsText(chunked);
+    chunked.end();
+    return;
+#endif /* ENABLE_EXTENDED_WEBUI */
+  } else if (reqPage == PAGE_CSS || reqPage == PAGE_JS) {
+    const byte *asset = ASSET_CSS;
+    uint16_t assetSize = sizeof(ASSET_CSS);
+    if (reqPage == PAGE_JS) {
+      asset = ASSET_JS;
+      assetSize = sizeof(ASSET_JS);
+    }
+    chunked.print(F("HTTP/1.1 200 OK\r\n"
+                    "Content-Type: text/"));
+    if (reqPage == PAGE_CSS) chunked.print(F("css"));
+    else chunked.print(F("javascript"));
+    chunked.print(F("\r\n"
+                    "Content-Encoding: gzip\r\n"
+                    "Cache-Control: no-cache\r\n"  // browser keeps the asset but always checks the ETag (answered by 304)
+                    "Content-Length: "));
+    chunked.print(assetSize);
+    chunked.print(F("\r\n"));
+    tagEtag(chunked);
+    chunked.print(F("\r\n"));
+    for (uint16_t i = 0; i < assetSize; i++) {
+      chunked.write(pgm_read_byte(asset + i));
+    }
+    chunked.flush();
+    return;
+  } else if (reqPage == PAGE_NOT_MODIFIED) {
+    chunked.print(F("HTTP/1.1 304 Not Modified\r\n"));
+    tagEtag(chunked);
+    chunked.print(F("\r\n"));
+    chunked.flush();
+    return;
   }
   chunked.print(F("HTTP/1.1 200 OK\r\n"
                   "Content-Type: text/html\r\n"
@@ -63,68 +162,20 @@ void sendPage(EthernetClient &client, byte reqPage) {
   }
   chunked.print(F("'>"
                   "<title>Altherma UDP Controller</title>"
-                  "<style>"
-                  /*
-                  HTML Tags
-                    h1 - main title of the page
-                    h4 - text in navigation menu and header of page content
-                    a - items in left navigation menu
-                    label - first cell of a row in content
-                  CSS Classes
-                    w - wrapper (includes m + c)
-                    m  - navigation menu (left)
-                    c - wrapper for the content of a page (incl. smaller header and main)
-                    q - row inside a content (default: top-aligned)
-                    r - row inside a content (adds: center-aligned)
-                    i - short input (byte or IP address octet)
-                    n - input type=number
-                    s - select input with numbers
-                    p - inputs disabled by id=o checkbox
-                    v - parameter value inputs
-                  CSS Ids
-                    o - checkbox which disables other checkboxes and inputs
-                    t - packet type select
-                  */
-                  "*{box-sizing:border-box}"
-                  "body{padding:1px;margin:0;font-family:sans-serif;height:100vh}"
-                  "body,.w,.c,.q{display:flex}"
-                  "body,.c{flex-flow:column}"
-                  ".w{flex-grow:1;min-height:0}"
-                  ".m{flex:0 0 20vw}"
-                  ".c{flex:1}"
-                  ".m,main{overflow:auto;padding:15px}"
-                  ".m,.q{padding:1px}"
-                  ".r{align-items:center}"
-                  "h1,h4{padding:10px}"
-                  "h1,.m,h4{background:#0067AC;margin:1px}"
-                  "a,h1,h4{color:white;text-decoration:none}"
-                  ".c h4{padding-left:30%}"
-                  "label{width:30%;text-align:right;margin-right:2px}"
-                  ".s{text-align:right}"
-                  ".s>option{direction:rtl}"
-                  ".i,.v{text-align:center;width:4ch;color:black}"
-                  ".n{width:10ch}"
-                  ".v{display:none}"
-                  "</style>"
+                  "<link rel=stylesheet href=s.css>"
+                  "<script src=s.js></script>"
                   "</head>"
-                  "<body onload=g(document.getElementById('o').checked)>"
-                  "<script>function g(h) {var x = document.getElementsByClassName('p');for (var i = 0; i < x.length; i++) {x[i].disabled = h}}</script"));
+                  "<body>"));
   if (reqPage == PAGE_STATUS) {
-    chunked.print(F("><script>"
-                    "var a;"
-                    "const b=()=>{"
-                    "fetch('d.json')"  // Call the fetch function passing the url of the API as a parameter
-                    ".then(e=>{return e.json();a=0})"
-                    ".then(f=>{for(var i in f){if(document.getElementById(i))document.getElementById(i).innerHTML=f[i];}})"
-                    ".catch(()=>{if(!a){alert('Connnection lost');a=1}})"
-                    "};"
-                    "setInterval(()=>b(),"));
+#ifdef ENABLE_EXTENDED_WEBUI
+    chunked.print(F("<script>s()</script>"));  // status changes are pushed by the server
+#else  /* ENABLE_EXTENDED_WEBUI */
+    chunked.print(F("<script>b("));
     chunked.print(FETCH_INTERVAL);
-    chunked.print(F(");"
-                    "</script"));
+    chunked.print(F(")</script>"));
+#endif /* ENABLE_EXTENDED_WEBUI */
   }
-  chunked.print(F(">"
-                  "<h1>Altherma UDP Controller</h1>"
+  chunked.print(F("<h1>Altherma UDP Controller</h1>"
                   "<div class=w>"
                   "<div class=m>"));
 
@@ -186,6 +237,440 @@ void sendPage(EthernetClient &client, byte reqPage) {
   chunked.end();         // closing tags not required </body></html>
 }
 
+#ifdef ENABLE_EXTENDED_WEBUI
+/**************************************************************************/
+/*!
+  @brief Pushes status values which changed since the last event to the
+  Server-Sent Events stream. Values are sent as a single JSON object
+  (same keys as d.json) in a "data:" field. Each value is rendered once
+  for its CRC, only changed values longer than EVENT_VALUE_SIZE are
+  rendered again.
+
+  @param client Ethernet TCP client with an open event stream
+*/
+/**************************************************************************/
+void sendEvents(EthernetClient &client) {
+  char webOutBuffer[WEB_OUT_BUFFER_SIZE];
+  ChunkedPrint chunked(client, webOutBuffer, sizeof(webOutBuffer));  // not chunked, used only as a write buffer
+  bool changed = false;
+  for (byte i = 0; i < JSON_LATENCY; i++) {  // diagnostics are not shown on the P1P2 Status page
+    CrcPrint crcPrint;
+    char crcBuffer[8];
+    ChunkedPrint crcChunked(crcPrint, crcBuffer, sizeof(crcBuffer));
+    jsonVal(crcChunked, i);
+    crcChunked.flush();
+    if (crcPrint.crc == eventHash[i] && eventRefresh == false) continue;
+    eventHash[i] = crcPrint.crc;
+    if (changed) {
+      chunked.print(F(",\""));
+    } else {
+      chunked.print(F("data:{\""));
+      changed = true;
+    }
+    chunked.print(i);
+    chunked.print(F("\":\""));
+    if (crcPrint.len <= EVENT_VALUE_SIZE) {
+      chunked.print(crcPrint.value);
+    } else {
+      jsonVal(chunked, i);  // longer value (changed) is rendered again
+    }
+    chunked.print(F("\""));
+  }
+  eventRefresh = false;
+  if (changed) {
+    chunked.print(F("}\n\n"));
+    chunked.flush();
+  }
+}
+
+/**************************************************************************/
+/*!
+  @brief Pushes P1P2 packet (as HEX string) to the Server-Sent Events stream,
+  if the stream was opened with "/events?p". Event type is "p".
+
+  @param packet Packet
+  @param packetLen Packet length
+*/
+/**************************************************************************/
+void sendEventPacket(const byte packet[], const byte packetLen) {
+  if (eventSocket == MAX_SOCK_NUM || eventPackets == false) return;
+  SPI.beginTransaction(SPI_ETHERNET_SETTINGS);
+  byte status = W5100.readSnSR(eventSocket);
+  SPI.endTransaction();
+  if (status != SnSR::ESTABLISHED) {  // stream closed since the last manageEvents(), socket may already belong to another client
+    eventSocket = MAX_SOCK_NUM;
+    return;
+  }
+  EthernetClient client = EthernetClient(eventSocket);
+  if (client.availableForWrite() < EVENT_MIN_FREE) return;  // client does not read, drop the packet
+  char webOutBuffer[WEB_OUT_BUFFER_SIZE];
+  ChunkedPrint chunked(client, webOutBuffer, sizeof(webOutBuffer));
+  chunked.print(F("event:p\ndata:"));
+  for (byte i = 0; i < packetLen; i++) {
+    chunked.print(hex(packet[i]));
+  }
+  chunked.print(F("\n\n"));
+  chunked.flush();
+}
+
+/**************************************************************************/
+/*!
+  @brief Prints counters and statistics in Prometheus text format (/metrics).
+
+  @param chunked Chunked buffer
+*/
+/**************************************************************************/
+void sendMetrics(ChunkedPrint &chunked) {
+  const __FlashStringHelper *name = F("uptime_seconds");
+  metricType(chunked, name, false);
+  metricValue(chunked, name, NULL, seconds);
+
+  name = F("p1p2_packets_total");
+  metricType(chunked, name, true);
+  metricValue(chunked, name, F("result=\"read_ok\""), data.p1p2Cnt[P1P2_READ_OK]);
+  metricValue(chunked, name, F("result=\"read_error\""), data.p1p2Cnt[P1P2_READ_ERROR]);
+  metricValue(chunked, name, F("result=\"write_ok\""), data.p1p2Cnt[P1P2_WRITE_OK]);
+  metricValue(chunked, name, F("result=\"write_error\""), data.p1p2Cnt[P1P2_WRITE_ERROR]);
+
+  name = F("udp_packets_total");
+  metricType(chunked, name, true);
+  metricValue(chunked, name, F("direction=\"sent\""), data.udpCnt[UDP_SENT]);
+  metricValue(chunked, name, F("direction=\"received\""), data.udpCnt[UDP_RECEIVED]);
+
+  name = F("daikin_eeprom_commands_total");
+  metricType(chunked, name, true);
+  metricValue(chunked, name, F("result=\"sent\""), data.eepromDaikin.total);
+  metricValue(chunked, name, F("result=\"dropped\""), data.eepromDaikin.dropped);
+  metricValue(chunked, name, F("result=\"invalid\""), data.eepromDaikin.invalid);
+
+  name = F("daikin_eeprom_commands_daily");
+  metricType(chunked, name, false);
+  metricValue(chunked, name, F("day=\"today\""), data.eepromDaikin.today);
+  metricValue(chunked, name, F("day=\"yesterday\""), data.eepromDaikin.yesterday);
+  metricValue(chunked, name, F("day=\"quota\""), data.config.writeQuota);
+
+  name = F("daikin_eeprom_write_tokens");  // token bucket
+  metricType(chunked, name, false);
+  metricValue(chunked, name, F("state=\"available\""), data.eepromDaikin.tokens);
+  metricValue(chunked, name, F("state=\"burst\""), data.config.writeBurst);
+
+  name = F("commands_confirmation_total");  // written commands confirmed by the main controller
+  metricType(chunked, name, true);
+  metricValue(chunked, name, F("result=\"confirmed\""), confirmCnt[CONFIRM_OK]);
+  metricValue(chunked, name, F("result=\"retried\""), confirmCnt[CONFIRM_RETRIED]);
+  metricValue(chunked, name, F("result=\"failed\""), confirmCnt[CONFIRM_FAILED]);
+  metricValue(chunked, name, F("result=\"unknown\""), confirmCnt[CONFIRM_UNKNOWN]);
+
+  name = F("command_confirmation_milliseconds");
+  metricType(chunked, name, false);
+  metricValue(chunked, name, F("stat=\"last\""), confirmTime[0]);
+  metricValue(chunked, name, F("stat=\"min\""), confirmTime[1]);
+  metricValue(chunked, name, F("stat=\"max\""), confirmTime[2]);
+
+  name = F("eeprom_writes_total");  // Arduino EEPROM
+  metricType(chunked, name, true);
+  metricValue(chunked, name, NULL, data.eepromWrites);
+
+  name = F("controller_address");  // 0 = disconnected, 1 = connecting, 0xF0 - 0xFF = connected
+  metricType(chunked, name, false);
+  metricValue(chunked, name, NULL, controllerAddr);
+
+  name = F("connect_milliseconds");  // time from the start of connecting to getting an address
+  metricType(chunked, name, false);
+  metricValue(chunked, name, NULL, connectTime);
+
+  name = F("bus_connected");
+  metricType(chunked, name, false);
+  metricValue(chunked, name, NULL, !p1p2Timer.isOver());
+
+  name = F("address_requests");  // FxRequests[], < 0 means another device uses the address
+  metricType(chunked, name, false);
+  for (byte i = 0; i < 16; i++) {
+    chunked.print(F("altherma_"));
+    chunked.print(name);
+    chunked.print(F("{address=\"F"));
+    chunked.print(i, HEX);
+    chunked.print(F("\"} "));
+    chunked.print(FxRequests[i]);
+    chunked.print(F("\n"));
+  }
+
+  name = F("queue_bytes");
+  metricType(chunked, name, false);
+  metricValue(chunked, name, F("state=\"used\""), cmdQueue.size());
+  metricValue(chunked, name, F("state=\"capacity\""), cmdQueue.capacity);
+
+  name = F("replies_total");
+  metricType(chunked, name, true);
+  metricValue(chunked, name, F("result=\"requests\""), replyCnt[REPLY_REQUESTS]);
+  metricValue(chunked, name, F("result=\"on_time\""), replyCnt[REPLY_ON_TIME]);
+  metricValue(chunked, name, F("result=\"late\""), replyCnt[REPLY_LATE]);
+  metricValue(chunked, name, F("result=\"skipped\""), replyCnt[REPLY_SKIPPED]);
+  metricValue(chunked, name, F("result=\"missed\""), replyCnt[REPLY_MISSED]);
+
+  name = F("reply_lag_milliseconds");  // time between the request and the moment the reply was scheduled for writing
+  metricTypeHistogram(chunked, name);
+  metricHistogram(chunked, name, NULL, NULL, 0, replyLag, LAG_BUCKETS, 0, replyLagSum);
+
+  name = F("reply_delay_milliseconds");
+  metricType(chunked, name, false);
+  metricValue(chunked, name, F("type=\"30\""), replyDelay(true));
+  metricValue(chunked, name, F("type=\"3x\""), replyDelay(false));
+
+  name = F("replies_late_total");
+  metricType(chunked, name, true);
+  for (byte i = 0; i < STAGE_LAST; i++) {
+    metricStage(chunked, name, i);
+    chunked.print(F("} "));
+    chunked.print(replyLateStage[i]);
+    chunked.print(F("\n"));
+  }
+
+  name = F("bus_cycle_milliseconds");  // data packets cycle (between two 000010 requests)
+  metricType(chunked, name, false);
+  metricValue(chunked, name, F("stat=\"last\""), cycle[0]);
+  metricValue(chunked, name, F("stat=\"min\""), cycle[1]);
+  metricValue(chunked, name, F("stat=\"max\""), cycle[2]);
+
+  name = F("bus_idle_percent");
+  metricType(chunked, name, false);
+  metricValue(chunked, name, NULL, busIdle());
+
+  if (hwID) {
+    name = F("voltage_millivolts");  // last interval
+    metricType(chunked, name, false);
+    metricValue(chunked, name, F("adc=\"bus\",stat=\"min\""), voltage[ADC_BUS].last[0]);
+    metricValue(chunked, name, F("adc=\"bus\",stat=\"avg\""), voltage[ADC_BUS].last[1]);
+    metricValue(chunked, name, F("adc=\"bus\",stat=\"max\""), voltage[ADC_BUS].last[2]);
+    metricValue(chunked, name, F("adc=\"supply\",stat=\"min\""), voltage[ADC_SUPPLY].last[0]);
+    metricValue(chunked, name, F("adc=\"supply\",stat=\"avg\""), voltage[ADC_SUPPLY].last[1]);
+    metricValue(chunked, name, F("adc=\"supply\",stat=\"max\""), voltage[ADC_SUPPLY].last[2]);
+
+    name = F("bus_voltage_sags_total");
+    metricType(chunked, name, true);
+    metricValue(chunked, name, NULL, sagCnt);
+
+    name = F("bus_voltage_sag_errors_total");  // P1P2 errors during intervals with bus voltage sag
+    metricType(chunked, name, true);
+    metricValue(chunked, name, NULL, sagErrors);
+  }
+
+  name = F("p1p2_errors_total");  // packets with errors by packet type and error class
+  metricType(chunked, name, true);
+  for (byte i = 0; i < TIMING_LAST; i++) {
+    for (byte j = 0; j < ERR_CLASS_LAST; j++) {
+      if (errorMatrix[i][j] == 0) continue;
+      chunked.print(F("altherma_"));
+      chunked.print(name);
+      chunked.print(F("{type=\""));
+      stringTiming(chunked, i);
+      chunked.print(F("\",class=\""));
+      stringErrorClass(chunked, j);
+      chunked.print(F("\"} "));
+      chunked.print(errorMatrix[i][j]);
+      chunked.print(F("\n"));
+    }
+  }
+
+  name = F("response_delay_milliseconds");  // response delays of other devices by packet type
+  metricTypeHistogram(chunked, name);
+  for (byte i = 0; i < TIMING_LAST; i++) {
+    metricHistogram(chunked, name, F("type"), stringTiming, i, responseDelay[i], LAG_BUCKETS, 0, responseDelaySum[i]);
+  }
+
+#ifdef MEASURE_LOAD
+  name = F("isr_packet_load_percent");  // share of packet time (not wall-clock time) spent in P1P2Serial timer ISRs while reading / writing a packet
+  metricType(chunked, name, false);
+  for (byte i = 0; i < LOAD_LAST; i++) {
+    uint32_t val = 0;
+    if (busLoad[i].lapsed) val = busLoad[i].isr * 100 / busLoad[i].lapsed;
+    metricValue(chunked, name, i == LOAD_READ ? F("dir=\"read\"") : F("dir=\"write\""), val);
+  }
+  name = F("isr_peak_nanoseconds_per_bit");
+  metricType(chunked, name, false);
+  for (byte i = 0; i < LOAD_LAST; i++) {
+    metricValue(chunked, name, i == LOAD_READ ? F("dir=\"read\"") : F("dir=\"write\""), busLoad[i].peak * 100UL);
+  }
+#endif /* MEASURE_LOAD */
+
+  name = F("loop_stage_microseconds");
+  metricType(chunked, name, false);
+  for (byte i = 0; i < STAGE_LAST; i++) {
+    if (latency[i].min == 0xFFFFFFFF) continue;  // no sample yet
+    for (byte j = 0; j < 2; j++) {
+      metricStage(chunked, name, i);
+      if (j == 0) {
+        chunked.print(F(",stat=\"min\"} "));
+        chunked.print(latency[i].min);
+      } else {
+        chunked.print(F(",stat=\"max\"} "));
+        chunked.print(latency[i].max);
+      }
+      chunked.print(F("\n"));
+    }
+  }
+  name = F("loop_stage_duration_microseconds");
+  metricTypeHistogram(chunked, name);
+  for (byte i = 0; i < STAGE_LAST; i++) {
+    metricHistogram(chunked, name, F("stage"), stringStage, i, latency[i].hist, LATENCY_BUCKETS, 6, latency[i].sum);
+  }
+}
+
+/**************************************************************************/
+/*!
+  @brief Prints field settings mirrored from the bus (/params), one param
+  per line: packet type, param number, param value (hex, bytes as on the bus).
+
+  @param chunked Chunked buffer
+*/
+/**************************************************************************/
+void sendParamsText(ChunkedPrint &chunked) {
+  for (byte i = 0; i < MAX_MIRROR_PARAMS; i++) {
+    if (mirror[i].type == 0) continue;  // reserved 0x36 slots may be empty
+    chunked.print(hex(mirror[i].type));
+    chunked.print(F(" "));
+    chunked.print(hex(mirror[i].param[1]));
+    chunked.print(hex(mirror[i].param[0]));
+    chunked.print(F(" "));
+    for (byte j = 0; j < PACKET_PARAM_VAL_SIZE[mirror[i].type - PACKET_TYPE_CONTROL[FIRST]]; j++) {
+      chunked.print(hex(mirror[i].val[j]));
+    }
+    chunked.print(F("\n"));
+  }
+}
+
+/**************************************************************************/
+/*!
+  @brief Prints name and stage label of a loop latency metric (label set is left open)
+
+  @param chunked Chunked buffer
+  @param name Metric name (without prefix)
+  @param stage Loop stage
+*/
+/**************************************************************************/
+void metricStage(ChunkedPrint &chunked, const __FlashStringHelper *name, const byte stage) {
+  chunked.print(F("altherma_"));
+  chunked.print(name);
+  chunked.print(F("{stage=\""));
+  stringStage(chunked, stage);
+  chunked.print(F("\""));
+}
+
+/**************************************************************************/
+/*!
+  @brief Prints TYPE line of a metric
+
+  @param chunked Chunked buffer
+  @param name Metric name (without prefix)
+  @param counter True for counter, false for gauge
+*/
+/**************************************************************************/
+void metricType(ChunkedPrint &chunked, const __FlashStringHelper *name, const bool counter) {
+  chunked.print(F("# TYPE altherma_"));
+  chunked.print(name);
+  if (counter) chunked.print(F(" counter\n"));
+  else chunked.print(F(" gauge\n"));
+}
+
+/**************************************************************************/
+/*!
+  @brief Prints TYPE line of a histogram metric
+
+  @param chunked Chunked buffer
+  @param name Metric name (without prefix)
+*/
+/**************************************************************************/
+void metricTypeHistogram(ChunkedPrint &chunked, const __FlashStringHelper *name) {
+  chunked.print(F("# TYPE altherma_"));
+  chunked.print(name);
+  chunked.print(F(" histogram\n"));
+}
+
+/**************************************************************************/
+/*!
+  @brief Prints samples of a histogram metric (cumulative buckets, sum and
+  count) from a log2 histogram. Upper limit of bucket i is
+  (1 << (i + shift)) - 1, values are integers.
+
+  @param chunked Chunked buffer
+  @param name Metric name (without prefix)
+  @param labelName Label name or NULL
+  @param labelValue Function which prints the label value
+  @param index Index passed to labelValue
+  @param hist Log2 histogram (non-cumulative)
+  @param buckets Number of buckets, the last one has no upper limit
+  @param shift Upper limit of the first bucket is (1 << shift) - 1
+  @param sum Sum of all observed values
+*/
+/**************************************************************************/
+void metricHistogram(ChunkedPrint &chunked, const __FlashStringHelper *name, const __FlashStringHelper *labelName, void (*labelValue)(ChunkedPrint &, const byte), const byte index, const uint32_t hist[], const byte buckets, const byte shift, const uint64_t sum) {
+  uint32_t count = 0;
+  for (byte i = 0; i < buckets + 2; i++) {  // buckets, _sum, _count
+    chunked.print(F("altherma_"));
+    chunked.print(name);
+    if (i < buckets) chunked.print(F("_bucket{"));
+    else if (i == buckets) chunked.print(F("_sum"));
+    else chunked.print(F("_count"));
+    if (labelName) {
+      if (i >= buckets) chunked.print(F("{"));
+      chunked.print(labelName);
+      chunked.print(F("=\""));
+      labelValue(chunked, index);
+      chunked.print(F("\""));
+      if (i < buckets) chunked.print(F(","));
+      else chunked.print(F("}"));
+    }
+    if (i < buckets) {
+      count += hist[i];
+      chunked.print(F("le=\""));
+      if (i < buckets - 1) {
+        chunked.print((1UL << (i + shift)) - 1);
+      } else {
+        chunked.print(F("+Inf"));
+      }
+      chunked.print(F("\"} "));
+      chunked.print(count);
+    } else if (i == buckets) {
+      chunked.print(F(" "));
+      if (sum >= 1000000000ULL) {  // Print does not support 64 bit numbers
+        chunked.print(uint32_t(sum / 1000000000ULL));
+        uint32_t low = sum % 1000000000ULL;
+        for (uint32_t d = 100000000UL; d > low && d > 1; d /= 10) chunked.print(F("0"));
+        chunked.print(low);
+      } else {
+        chunked.print(uint32_t(sum));
+      }
+    } else {
+      chunked.print(F(" "));
+      chunked.print(count);
+    }
+    chunked.print(F("\n"));
+  }
+}
+
+/**************************************************************************/
+/*!
+  @brief Prints one sample of a metric
+
+  @param chunked Chunked buffer
+  @param name Metric name (without prefix)
+  @param label Label (key="value") or NULL
+  @param value Value
+*/
+/**************************************************************************/
+void metricValue(ChunkedPrint &chunked, const __FlashStringHelper *name, const __FlashStringHelper *label, const uint32_t value) {
+  chunked.print(F("altherma_"));
+  chunked.print(name);
+  if (label) {
+    chunked.print(F("{"));
+    chunked.print(label);
+    chunked.print(F("}"));
+  }
+  chunked.print(F(" "));
+  chunked.print(value);
+  chunked.print(F("\n"));
+}
+#endif /* ENABLE_EXTENDED_WEBUI */
 
 /**************************************************************************/
 /*!
@@ -243,7 +728,7 @@ void contentInfo(ChunkedPrint &chunked) {
   } else if (dhcpSuccess == true) {
     chunked.print(F("Success"));
   } else {
-    chunked.print(F("Failed, using fallback static IP"));
+    chunked.print(F("Requesting, using fallback static IP"));
   }
   tagDivClose(chunked);
 #endif /* ENABLE_DHCP */
@@ -251,6 +736,37 @@ void contentInfo(ChunkedPrint &chunked) {
   tagLabelDiv(chunked, F("IP Address"));
   chunked.print(IPAddress(Ethernet.localIP()));
   tagDivClose(chunked);
+#ifdef MEASURE_LOAD
+  tagLabelDiv(chunked, F("P1P2 ISR Load"), true);
+  for (byte i = 0; i < LOAD_LAST; i++) {
+    if (i == LOAD_READ) chunked.print(F("Read: "));
+    else chunked.print(F("<br>Write: "));
+    if (busLoad[i].lapsed < BIT_TIME_X10) {
+      chunked.print(F("-"));
+      continue;
+    }
+    stringTenths(chunked, busLoad[i].isr / (busLoad[i].lapsed / BIT_TIME_X10));
+    chunked.print(F(" us avg, "));
+    stringTenths(chunked, busLoad[i].peak);
+    chunked.print(F(" us peak per bit, "));
+    chunked.print(busLoad[i].isr * 100 / busLoad[i].lapsed);
+    chunked.print(F(" % of packet time"));
+  }
+  tagDivClose(chunked);
+#endif /* MEASURE_LOAD */
+  tagLabelDiv(chunked, F("Boot Timeline"), true);
+  for (byte i = 0; i < BOOT_LAST; i++) {
+    if (i > 0) chunked.print(F("<br>"));
+    stringBoot(chunked, i);
+    chunked.print(F(": "));
+    if (bootDone & (1 << i)) {
+      chunked.print(bootTime[i]);
+      chunked.print(F(" ms"));
+    } else {
+      chunked.print(F("-"));
+    }
+  }
+  tagDivClose(chunked);
 #endif /* ENABLE_EXTENDED_WEBUI */
 }
 
@@ -276,30 +792,25 @@ void contentStatus(ChunkedPrint &chunked) {
   tagLabelDiv(chunked, F("This Controller"), true);
   tagSpan(chunked, JSON_CONTROLLER);
   tagDivClose(chunked);
+#ifdef ENABLE_EXTENDED_WEBUI
+  tagLabelDiv(chunked, F("Replies"), true);
+  tagSpan(chunked, JSON_REPLIES);
+  tagDivClose(chunked);
+  tagLabelDiv(chunked, F("Bus Timing"), true);
+  tagSpan(chunked, JSON_BUS_TIMING);
+  tagDivClose(chunked);
+  if (hwID) {
+    tagLabelDiv(chunked, F("Bus Voltage"), true);
+    tagSpan(chunked, JSON_VOLTAGE);
+    tagDivClose(chunked);
+  }
+#endif /* ENABLE_EXTENDED_WEBUI */
   // #ifdef ENABLE_EXTENDED_WEBUI
   tagLabelDiv(chunked, F("Other Controllers"), true);
   tagSpan(chunked, JSON_OTHER_CONTROLLERS);
   tagDivClose(chunked);
   // #endif /* ENABLE_EXTENDED_WEBUI */
-  chunked.print(F("</form><form method=post>"
-                  "<script>"
-                  "window.onload=()=>{const l={"));
-  for (byte i = PACKET_TYPE_CONTROL[FIRST]; i <= PACKET_TYPE_CONTROL[LAST]; i++) {
-    if (PACKET_PARAM_VAL_SIZE[i - PACKET_TYPE_CONTROL[FIRST]] == 0) continue;
-    chunked.print(F("'"));
-    chunked.print(hex(i));
-    chunked.print(F("':["));
-    for (byte j = 1; j <= PACKET_PARAM_VAL_SIZE[i - PACKET_TYPE_CONTROL[FIRST]]; j++) {
-      chunked.print(F("'v"));
-      chunked.print(j);
-      chunked.print(F("',"));
-    }
-    chunked.print(F("],"));
-  }
-  chunked.print(F("};"
-                  "const u=v=>document.querySelectorAll('.v').forEach(f=>{const s=l[v]?.includes(f.id);f.style.display=s?'inline':'none';f.required=!!s});"
-                  "const t=document.getElementById('t');t.onchange=()=>u(t.value);u(t.value);};"
-                  "</script>"));
+  chunked.print(F("</form><form method=post>"));
   tagLabelDiv(chunked, F("Write Command"));
   chunked.print(F("Packet Type "
                   "<select name="));
@@ -309,6 +820,8 @@ void contentStatus(ChunkedPrint &chunked) {
     if (PACKET_PARAM_VAL_SIZE[i - PACKET_TYPE_CONTROL[FIRST]] == 0) continue;
     chunked.print(F("<option value="));
     chunked.print(hex(i));
+    chunked.print(F(" data-n="));  // number of parameter values, used by s.js
+    chunked.print(PACKET_PARAM_VAL_SIZE[i - PACKET_TYPE_CONTROL[FIRST]]);
     chunked.print(F(">"));
     chunked.print(hex(i));
     chunked.print(F("</option>"));
@@ -333,6 +846,11 @@ void contentStatus(ChunkedPrint &chunked) {
   tagLabelDiv(chunked, 0);
   tagSpan(chunked, JSON_DAIKIN_EEPROM);
   tagDivClose(chunked);
+#ifdef ENABLE_EXTENDED_WEBUI
+  tagLabelDiv(chunked, F("Write Confirmation"));
+  tagSpan(chunked, JSON_CONFIRM);
+  tagDivClose(chunked);
+#endif /* ENABLE_EXTENDED_WEBUI */
 #ifdef ENABLE_EXTENDED_WEBUI
   tagLabelDiv(chunked, F("Run Time"));
   tagSpan(chunked, JSON_RUNTIME);
@@ -370,7 +888,7 @@ void contentIp(ChunkedPrint &chunked) {
 
 #ifdef ENABLE_DHCP
   tagLabelDiv(chunked, F("Auto IP"));
-  tagCheckbox(chunked, POST_SEND_ALL, data.config.enableDhcp, true, false);
+  tagCheckbox(chunked, POST_DHCP, data.config.enableDhcp, true, false);
   chunked.print(F(" DHCP"));
   tagDivClose(chunked);
 #endif /* ENABLE_DHCP */
@@ -450,9 +968,21 @@ void contentP1P2(ChunkedPrint &chunked) {
   tagLabelDiv(chunked, F("Daikin EEPROM Write Quota"));
   tagInputNumber(chunked, POST_QUOTA, 0, 100, data.config.writeQuota, F("writes per day"));
   tagDivClose(chunked);
+  tagLabelDiv(chunked, F("Daikin EEPROM Write Burst"));
+  tagInputNumber(chunked, POST_BURST, WRITE_RESERVE + 1, 100, data.config.writeBurst, F("writes"));
+  tagDivClose(chunked);
   tagLabelDiv(chunked, F("Target Temperature Hysteresis"));
   tagInputNumber(chunked, POST_HYSTERESIS, 0, 100, data.config.hysteresis, F("°C"));
   tagDivClose(chunked);
+#ifdef ENABLE_EXTENDED_WEBUI
+  tagLabelDiv(chunked, F("Reply Delay"));
+  static const __FlashStringHelper *delayList[] = {
+    F("Fixed"),
+    F("Adaptive")
+  };
+  tagSelect(chunked, POST_REPLY_DELAY, delayList, 2, data.config.replyDelay);
+  tagDivClose(chunked);
+#endif /* ENABLE_EXTENDED_WEBUI */
 }
 
 /**************************************************************************/
@@ -480,9 +1010,33 @@ void contentFilter(ChunkedPrint &chunked) {
   };
   tagSelect(chunked, POST_DATA_PACKETS, optionsList, 3, data.config.sendDataPackets);
   tagDivClose(chunked);
+#ifdef ENABLE_EXTENDED_WEBUI
+  tagLabelDiv(chunked, F("Data Summary"));
+  static const __FlashStringHelper *summaryList[] = {
+    F("Disabled"),
+    F("Send Summary and Data Packets"),
+    F("Send Summary Instead of Data Packets")
+  };
+  tagSelect(chunked, POST_SUMMARY_MODE, summaryList, 3, data.config.summaryMode);
+  tagDivClose(chunked);
+  tagLabelDiv(chunked, F("Data Summary Period"));
+  tagInputNumber(chunked, POST_SUMMARY_PERIOD, 1, 60, data.config.summaryPeriod, F("mins"));
+  tagDivClose(chunked);
+#endif /* ENABLE_EXTENDED_WEBUI */
   for (byte i = PACKET_TYPE_DATA[FIRST]; i <= PACKET_TYPE_DATA[LAST]; i++) {
     tagRowPacket(chunked, i);
   }
+#ifdef ENABLE_EXTENDED_WEBUI
+  tagLabelDiv(chunked, F("Data Packet Layout"));
+  byte learned = 0;
+  for (byte i = 0; i < DATA_PACKETS_CNT; i++) {
+    if (learnedSizes[0] & masks[i]) learned++;
+    if (learnedSizes[1] & masks[i]) learned++;
+  }
+  chunked.print(learned);
+  chunked.print(F(" Payload Sizes Learned"));
+  tagDivClose(chunked);
+#endif /* ENABLE_EXTENDED_WEBUI */
   tagLabelDiv(chunked, F("Other Packets"));
   tagDivClose(chunked);
   for (byte i = 0;; i++) {
@@ -510,6 +1064,39 @@ void contentTools(ChunkedPrint &chunked) {
   tagLabelDiv(chunked, 0);
   tagButton(chunked, F("Reboot"), ACT_REBOOT, true);
   tagDivClose(chunked);
+#ifdef ENABLE_EXTENDED_WEBUI
+  tagLabelDiv(chunked, F("Loop Latency"), true);
+  tagSpan(chunked, JSON_LATENCY);
+  tagDivClose(chunked);
+  tagLabelDiv(chunked, F("P1P2 Errors"), true);
+  tagSpan(chunked, JSON_ERRORS);
+  tagDivClose(chunked);
+  tagLabelDiv(chunked, F("Packet History"));
+  chunked.print(historyCnt);
+  chunked.print(F(" packets (<a href=history?hex>hex</a>, <a href=history>binary</a>)"));
+  tagDivClose(chunked);
+  tagLabelDiv(chunked, F("Field Settings"));
+  byte params = 0;
+  for (byte i = 0; i < MAX_MIRROR_PARAMS; i++) {
+    if (mirror[i].type != 0) params++;
+  }
+  chunked.print(F("<a href=params>"));
+  chunked.print(params);
+  chunked.print(F(" params</a> seen on the bus"));
+  tagDivClose(chunked);
+#endif /* ENABLE_EXTENDED_WEBUI */
+#ifdef SW_SCOPE
+  tagLabelDiv(chunked, F("Bus Scope"));
+  if (scopeEnabled) {
+    tagButton(chunked, F("Stop"), ACT_SCOPE, true);
+  } else {
+    tagButton(chunked, F("Start"), ACT_SCOPE, true);
+  }
+  chunked.print(F(" (UDP port "));
+  chunked.print(data.config.udpPort + SCOPE_PORT_OFFSET);
+  chunked.print(F(")"));
+  tagDivClose(chunked);
+#endif /* SW_SCOPE */
 }
 
 
@@ -778,6 +1365,21 @@ void tagSpan(ChunkedPrint &chunked, const byte JSONKEY) {
   chunked.print(F("</span>"));
 }
 
+/**************************************************************************/
+/*!
+  @brief ETag header of static assets (firmware version)
+
+  @param chunked Chunked buffer
+*/
+/**************************************************************************/
+void tagEtag(ChunkedPrint &chunked) {
+  chunked.print(F("ETag: \""));
+  chunked.print(VERSION[0]);
+  chunked.print(F("."));
+  chunked.print(VERSION[1]);
+  chunked.print(F("\"\r\n"));
+}
+
 /**************************************************************************/
 /*!
   @brief Menu item strings
@@ -814,6 +1416,142 @@ void stringPageName(ChunkedPrint &chunked, byte item) {
   }
 }
 
+#ifdef ENABLE_EXTENDED_WEBUI
+/**************************************************************************/
+/*!
+  @brief Boot stage strings
+
+  @param chunked Chunked buffer
+  @param stage Boot stage
+*/
+/**************************************************************************/
+void stringBoot(ChunkedPrint &chunked, const byte stage) {
+  switch (stage) {
+    case BOOT_BUS:
+      chunked.print(F("P1P2 Bus Started"));
+      break;
+    case BOOT_CONFIG:
+      chunked.print(F("Config Loaded"));
+      break;
+    case BOOT_ETHERNET:
+      chunked.print(F("Ethernet Started"));
+      break;
+    case BOOT_PACKET:
+      chunked.print(F("First P1P2 Packet"));
+      break;
+    case BOOT_DHCP:
+      chunked.print(F("DHCP Lease"));
+      break;
+    default:
+      break;
+  }
+}
+
+/**************************************************************************/
+/*!
+  @brief Loop stage strings
+
+  @param chunked Chunked buffer
+  @param stage Loop stage
+*/
+/**************************************************************************/
+void stringStage(ChunkedPrint &chunked, const byte stage) {
+  switch (stage) {
+    case STAGE_BUS:
+      chunked.print(F("P1P2 Bus"));
+      break;
+    case STAGE_UDP:
+      chunked.print(F("UDP"));
+      break;
+    case STAGE_WEB:
+      chunked.print(F("Web Server"));
+      break;
+    case STAGE_CONTROLLER:
+      chunked.print(F("Controller"));
+      break;
+    case STAGE_EEPROM:
+      chunked.print(F("EEPROM"));
+      break;
+    case STAGE_DHCP:
+      chunked.print(F("DHCP"));
+      break;
+    case STAGE_MAINTAIN:
+      chunked.print(F("Maintenance"));
+      break;
+    case STAGE_LOOP:
+      chunked.print(F("Whole Loop"));
+      break;
+    default:
+      break;
+  }
+}
+
+/**************************************************************************/
+/*!
+  @brief Packet type strings for response delay and error statistics
+
+  @param chunked Chunked buffer
+  @param row Row in responseDelay[]
+*/
+/**************************************************************************/
+void stringTiming(ChunkedPrint &chunked, const byte row) {
+  if (row < DATA_PACKETS_CNT) {
+    chunked.print(hex(PACKET_TYPE_DATA[FIRST] + row));
+  } else if (row == TIMING_CONTROL) {
+    chunked.print(F("3x"));
+  } else {
+    chunked.print(F("Other"));
+  }
+}
+
+/**************************************************************************/
+/*!
+  @brief Error class strings for P1P2 error statistics
+
+  @param chunked Chunked buffer
+  @param errorClass Error class (column in errorMatrix[])
+*/
+/**************************************************************************/
+void stringErrorClass(ChunkedPrint &chunked, const byte errorClass) {
+  switch (errorClass) {
+    case ERR_CLASS_SB:
+      chunked.print(F("SB"));
+      break;
+    case ERR_CLASS_BE:
+      chunked.print(F("BE"));
+      break;
+    case ERR_CLASS_BC:
+      chunked.print(F("BC"));
+      break;
+    case ERR_CLASS_PE:
+      chunked.print(F("PE"));
+      break;
+    case ERR_CLASS_OR:
+      chunked.print(F("OR"));
+      break;
+    case ERR_CLASS_CRC:
+      chunked.print(F("CRC"));
+      break;
+    default:
+      break;
+  }
+}
+#endif /* ENABLE_EXTENDED_WEBUI */
+
+/**************************************************************************/
+/*!
+  @brief Prints number in tenths as decimal (e.g. 123 as 12.3)
+
+  @param chunked Chunked buffer
+  @param value Value in tenths
+*/
+/**************************************************************************/
+void stringTenths(ChunkedPrint &chunked, const uint32_t value) {
+  chunked.print(value / 10);
+  chunked.print(F("."));
+  chunked.print(value % 10);
+}
+
 /**************************************************************************/
 /*!
   @brief Prints date and time
@@ -899,6 +1637,181 @@ void jsonVal(ChunkedPrint &chunked, const byte JSONKEY) {
         chunked.print(F(" Write Error"));
       }
       break;
+    case JSON_REPLIES:
+      {
+        for (byte i = 0; i < REPLY_LAST; i++) {
+          chunked.print(replyCnt[i]);
+          switch (i) {
+            case REPLY_REQUESTS:
+              chunked.print(F(" Requests"));
+              break;
+            case REPLY_ON_TIME:
+              chunked.print(F(" On Time"));
+              break;
+            case REPLY_LATE:
+              chunked.print(F(" Late"));
+              break;
+            case REPLY_SKIPPED:
+              chunked.print(F(" Skipped (write pending)"));
+              break;
+            case REPLY_MISSED:
+              chunked.print(F(" Missed (not read back)"));
+              break;
+            default:
+              break;
+          }
+          chunked.print(F("<br>"));
+        }
+        chunked.print(F("Reply Delay: "));
+        chunked.print(replyDelay(true));
+        chunked.print(F(" ms (0x30), "));
+        chunked.print(replyDelay(false));
+        chunked.print(F(" ms (0x31-0x3E)<br>"));
+        chunked.print(F("Lag Histogram (0, 1, 2-3, 4-7, ... ms):"));
+        for (byte i = 0; i < LAG_BUCKETS; i++) {
+          chunked.print(F(" "));
+          chunked.print(replyLag[i]);
+        }
+        if (replyCnt[REPLY_LATE]) {
+          chunked.print(F("<br>Late After:"));
+          for (byte i = 0; i < STAGE_LAST; i++) {
+            if (replyLateStage[i] == 0) continue;
+            chunked.print(F(" "));
+            stringStage(chunked, i);
+            chunked.print(F(" ("));
+            chunked.print(replyLateStage[i]);
+            chunked.print(F(")"));
+          }
+        }
+      }
+      break;
+    case JSON_BUS_TIMING:
+      {
+        chunked.print(F("Cycle 0x10-0x16: "));
+        chunked.print(cycle[0]);
+        chunked.print(F(" ms (min "));
+        chunked.print(cycle[1]);
+        chunked.print(F(" ms, max "));
+        chunked.print(cycle[2]);
+        chunked.print(F(" ms)<br>Bus Idle: "));
+        chunked.print(busIdle());
+        chunked.print(F(" %<br>Response Delay Histogram (0, 1, 2-3, 4-7, ... ms):"));
+        for (byte i = 0; i < TIMING_LAST; i++) {
+          uint32_t sum = 0;
+          for (byte j = 0; j < LAG_BUCKETS; j++) sum += responseDelay[i][j];
+          if (sum == 0) continue;
+          chunked.print(F("<br>"));
+          stringTiming(chunked, i);
+          chunked.print(F(":"));
+          for (byte j = 0; j < LAG_BUCKETS; j++) {
+            chunked.print(F(" "));
+            chunked.print(responseDelay[i][j]);
+          }
+        }
+      }
+      break;
+    case JSON_CONFIRM:
+      {
+        byte pending = 0;
+        for (byte i = 0; i < MAX_PENDING_CMDS; i++) {
+          if (pendingCmds[i].cmd[0] != 0) pending++;
+        }
+        chunked.print(pending);
+        chunked.print(F(" Pending<br>"));
+        chunked.print(confirmCnt[CONFIRM_OK]);
+        chunked.print(F(" Confirmed<br>"));
+        chunked.print(confirmCnt[CONFIRM_RETRIED]);
+        chunked.print(F(" Retried<br>"));
+        chunked.print(confirmCnt[CONFIRM_FAILED]);
+        chunked.print(F(" Failed<br>"));
+        chunked.print(confirmCnt[CONFIRM_UNKNOWN]);
+        chunked.print(F(" Unknown<br>Latency: "));
+        for (byte i = 0; i < 3; i++) {
+          if (i) chunked.print(i == 1 ? F(" s (min ") : F(" s, max "));
+          stringTenths(chunked, confirmTime[i] / 100);
+        }
+        chunked.print(F(" s)"));
+      }
+      break;
+    case JSON_VOLTAGE:
+      {
+        static const __FlashStringHelper *adcNames[] = { F("Bus"), F("Supply") };
+        for (byte i = 0; i < ADC_LAST; i++) {
+          chunked.print(adcNames[i]);
+          chunked.print(F(": "));
+          for (byte j = 0; j < 3; j++) {
+            if (j) chunked.print(F(" / "));
+            stringTenths(chunked, voltage[i].last[j] / 100);
+          }
+          chunked.print(F(" V (min / avg / max), since reset "));
+          stringTenths(chunked, voltage[i].min / 100);
+          chunked.print(F(" - "));
+          stringTenths(chunked, voltage[i].max / 100);
+          chunked.print(F(" V<br>"));
+        }
+        chunked.print(sagCnt);
+        chunked.print(F(" Intervals Below "));
+        stringTenths(chunked, BUS_VOLTAGE_LOW / 100);
+        chunked.print(F(" V with "));
+        chunked.print(sagErrors);
+        chunked.print(F(" P1P2 Errors"));
+      }
+      break;
+    case JSON_LATENCY:
+      {
+        tagButton(chunked, F("Reset"), ACT_RESET_LATENCY, true);
+        chunked.print(F("<br>Min - Max us | Histogram &lt;64 us, &lt;128 us, ... &gt;65 ms<br>"));
+        for (byte i = 0; i < STAGE_LAST; i++) {
+          stringStage(chunked, i);
+          chunked.print(F(": "));
+          if (latency[i].min == 0xFFFFFFFF) chunked.print(F("-"));  // no sample yet
+          else chunked.print(latency[i].min);
+          chunked.print(F(" - "));
+          chunked.print(latency[i].max);
+          chunked.print(F(" |"));
+          for (byte j = 0; j < LATENCY_BUCKETS; j++) {
+            chunked.print(F(" "));
+            chunked.print(latency[i].hist[j]);
+          }
+          chunked.print(F("<br>"));
+        }
+      }
+      break;
+    case JSON_ERRORS:
+      {
+        chunked.print(F("Packet Type | SB BE BC PE OR CRC"));
+        for (byte i = 0; i < TIMING_LAST; i++) {
+          uint32_t sum = 0;
+          for (byte j = 0; j < ERR_CLASS_LAST; j++) sum += errorMatrix[i][j];
+          if (sum == 0) continue;
+          chunked.print(F("<br>"));
+          stringTiming(chunked, i);
+          chunked.print(F(" |"));
+          for (byte j = 0; j < ERR_CLASS_LAST; j++) {
+            chunked.print(F(" "));
+            chunked.print(errorMatrix[i][j]);
+          }
+        }
+        for (byte i = 0; i < ERROR_BURSTS; i++) {
+          burst_t &b = bursts[(burstIdx + ERROR_BURSTS - i) % ERROR_BURSTS];  // newest first
+          if (b.packets == 0) break;
+          chunked.print(F("<br>Burst "));
+          chunked.print((millis() - b.start) / 1000);
+          chunked.print(F(" s ago, "));
+          if (b.cycleOffset != 0xFFFF) {
+            chunked.print(b.cycleOffset);
+            chunked.print(F(" ms into cycle, "));
+          }
+          chunked.print(b.packets);
+          chunked.print(F(" packets:"));
+          for (byte j = 0; j < ERR_CLASS_LAST; j++) {
+            if (!(b.flags & ERROR_CLASS_FLAG[j])) continue;
+            chunked.print(F(" "));
+            stringErrorClass(chunked, j);
+          }
+        }
+      }
+      break;
 #endif /* ENABLE_EXTENDED_WEBUI */
     case JSON_OTHER_CONTROLLERS:
       {
@@ -953,9 +1866,17 @@ void jsonVal(ChunkedPrint &chunked, const byte JSONKEY) {
         chunked.print(data.eepromDaikin.yesterday);
         chunked.print(F(" Yesterday<br>"));
         chunked.print(data.eepromDaikin.today);
+        chunked.print(F(" Today<br>"));
+        chunked.print(data.eepromDaikin.tokens);
         chunked.print(F(" out of "));
-        chunked.print(data.config.writeQuota);
-        chunked.print(F(" Today "));
+        chunked.print(data.config.writeBurst);
+        chunked.print(F(" Writes Available<br>"));
+        byte deferred = 0;
+        for (byte i = 0; i < MAX_DEFERRED_CMDS; i++) {
+          if (deferredCmds[i][0]) deferred++;
+        }
+        chunked.print(deferred);
+        chunked.print(F(" Deferred "));
         tagButton(chunked, F("Clear Quota"), ACT_CLEAR_QUOTA, true);
       }
       break;
@@ -977,6 +1898,13 @@ void jsonVal(ChunkedPrint &chunked, const byte JSONKEY) {
           chunked.print(F("(address 0x"));
           chunked.print(controllerAddr, HEX);
           chunked.print(F(") "));
+#ifdef ENABLE_EXTENDED_WEBUI
+          if (connectTime) {
+            chunked.print(F("in "));
+            stringTenths(chunked, connectTime / 100);
+            chunked.print(F(" s "));
+          }
+#endif /* ENABLE_EXTENDED_WEBUI */
           if (data.config.controllerMode == CONTROL_MANUAL) {
             tagButton(chunked, F("Disable Write"), ACT_DISCONNECT, true);
           }
@@ -13,6 +13,11 @@
 #define ENABLE_DHCP
 #endif
 
+// #define ENABLE_BUS_SCOPE  // Enable Bus Scope (timing of P1/P2 bus edges streamed via UDP, see Tools page), only on Arduino Mega, consumes ~1.7 kB SRAM (packet history gets smaller)
+// this section is also read by the P1P2Serial library (src/P1P2Serial_mod), keep it free of anything but #define
+
+#ifndef SETTINGS_FUNCTIONALITY_ONLY
+
 /****** DEFAULT CONFIGURATION ******/
 /*
   Arduino loads user settings stored in EEPROM, even if you flash new program to it.
@@ -42,13 +47,17 @@ const uint16_t DEFAULT_WEB_PORT = 80;     // Default WebUI Port
 
 /****** P1P2 Settings ******/
 const byte DEFAULT_COTROLLER_MODE = CONTROL_MANUAL;  // Default Controller Mode (CONTROL_MANUAL or CONTROL_AUTO)
-const byte DEFAULT_EEPROM_QUOTA = 24;                // Default EEPROM Write Quota
+const byte DEFAULT_EEPROM_QUOTA = 24;                // Default EEPROM Write Quota (write tokens added per day)
+const byte DEFAULT_EEPROM_BURST = 10;                // Default EEPROM Write Burst (max number of write tokens, must be greater than WRITE_RESERVE)
+const byte DEFAULT_REPLY_DELAY = DELAY_FIXED;        // Default Reply Delay (DELAY_FIXED or DELAY_ADAPTIVE, only used if ENABLE_EXTENDED_WEBUI)
 const byte DEFAUT_TEMPERATURE_HYSTERESIS = 10;       // Default Target Temperature Hysteresis in 1/10 °C
 
 /****** Packet Filter ******/
 const bool DEFAULT_SEND_ALL = false;                             // Default Send All Packet Types
 const byte DEFAULT_COUNTER_PERIOD = 10;                          // Default Counters Packet Request Period
 const byte DEFAULT_DATA_PACKETS_MODE = DATA_CHANGE_AND_REQUEST;  // Default Data Packets Mode (DATA_ALWAYS, DATA_CHANGE_AND_REQUEST or DATA_ONLY_CHANGE)
+const byte DEFAULT_SUMMARY_MODE = SUMMARY_OFF;                   // Default Data Summary Mode (SUMMARY_OFF, SUMMARY_AND_RAW or SUMMARY_ONLY, only used if ENABLE_EXTENDED_WEBUI)
+const byte DEFAULT_SUMMARY_PERIOD = 1;                           // Default Data Summary Period (minutes)
 
 
 /****** ADVANCED SETTINGS ******/
@@ -59,21 +68,89 @@ const byte PACKET_TYPE_CONTROL[2] = { 0x30, 0x3E };  // First and last control p
 const byte PACKET_TYPE_INDOOR_NAME = 0xB1;           // Heat pump indoorname packet type
 const byte PACKET_TYPE_OUTDOOR_NAME = 0xA1;          // Heat pump outdoor name packet type
 const byte PACKET_TYPE_COUNTER = 0xB8;               // Counters packet type
+const byte COUNTER_SUBTYPES = 6;                     // Number of counter packet sub-types (0x00 - 0x05) requested in each sweep
+const byte COUNTER_STATIC_SWEEPS = 3;                // Counter sub-types unchanged in this number of sweeps are skipped in regular sweeps (extended web UI only)
+const byte COUNTER_FULL_SWEEP = 12;                  // Every n-th regular sweep requests all counter sub-types (extended web UI only)
 const byte F030DELAY = 100;                          // Time delay for in ms auxiliary controller simulation, should be larger than any response of other auxiliary controllers (which is typically 25-80 ms)
 const byte F03XDELAY = 50;                           // Time delay for in ms auxiliary controller simulation, should preferably be a bit larger than any regular response from auxiliary controllers (which is typically 25 ms)
+const byte MIN_REPLY_DELAY = 10;                     // Minimum time delay in ms for adaptive reply delays
+const byte REPLY_DELAY_MARGIN = 10;                  // Adaptive reply delay is the longest response of other auxiliary controllers + REPLY_DELAY_MARGIN (in ms)
+const byte REPLY_DELAY_BACKOFF = 10;                 // Time in ms added to adaptive reply delays after each collision (write error)
+const byte REPLY_DELAY_RECOVERY = 64;                // Backoff is decreased by 1 ms after REPLY_DELAY_RECOVERY replies read back without errors
 const byte F0THRESHOLD = 5;                          // Number of 00Fx30 messages to remain unanswered before we feel safe to act as auxiliary controller
                                                      // Each message takes ~770ms so we can use F0THRESHOLD to set minimum and default connectTimeout
+const byte LAST_ADDR_THRESHOLD = 2;                  // Lower threshold for the last address used by this controller (stored in EEPROM), for faster reconnection after reboot
 
 const byte DATA_PACKETS_CNT = PACKET_TYPE_DATA[LAST] - PACKET_TYPE_DATA[FIRST] + 1;
 const byte CTRL_PACKETS_CNT = PACKET_TYPE_CONTROL[LAST] - PACKET_TYPE_CONTROL[FIRST] + 1;
 //byte packetsrc                                    = { { 00                      }, { 40                       } };
 //byte packettype                                   = { { 10,11, 12,13, 14,15, 16 }, { 10, 11, 12, 13, 14,15,16 } };
-const byte PACKET_PAYLOAD_SIZE[2][DATA_PACKETS_CNT] = { { 20, 8, 15, 3, 15, 6, 16 }, { 20, 20, 20, 16, 19, 9, 9 } };  // sum is SAVED_PACKETS_SIZE = 196
-const byte SAVED_PACKETS_SIZE = 196;                                                                                  // if SAVED_PACKETS_SIZE > 256, change datatype for these variables: SAVED_PACKETS_SIZE, bytestart, pi2
+const byte PACKET_PAYLOAD_SIZE[2][DATA_PACKETS_CNT] = { { 20, 8, 15, 3, 15, 6, 16 }, { 20, 20, 20, 16, 19, 9, 9 } };  // initial payload sizes (Hybrid / LT), actual sizes are learned from the bus
+#ifdef ENABLE_EXTENDED_WEBUI
+const byte SAVED_PACKETS_SIZE = 240;  // room for learned payloads longer than PACKET_PAYLOAD_SIZE
+#else
+const byte SAVED_PACKETS_SIZE = 196;  // if SAVED_PACKETS_SIZE > 256, change datatype for these variables: SAVED_PACKETS_SIZE, pi2
+#endif
+const byte PACKET_CACHE_SIZE = 32;      // max number of other (non-data) packets remembered for "payload changed" detection, 7 bytes of RAM each (only used if ENABLE_EXTENDED_WEBUI)
+const byte PACKET_TYPE_SUBTYPE = 0xA0;  // packet types from 0xA0 have sub-type in the first payload byte (0xA1, 0xB1, 0xB8, etc.)
 //byte packettype                                  = {30,31,32,33,34,35,36,37,38,39,3A,3B,3C,3D,3E }
 const byte PACKET_PARAM_VAL_SIZE[CTRL_PACKETS_CNT] = { 0, 0, 0, 0, 0, 1, 2, 3, 4, 4, 1, 2, 3, 4, 0 };  // 0 = write command not supported (yet)
+// Data payload fields (signed f8.8, 2 bytes) summarized in the data summary (only used if ENABLE_EXTENDED_WEBUI)
+typedef struct {
+  byte header;  // first byte of the packet (0x00 request, 0x40 response)
+  byte type;    // packet type
+  byte offset;  // offset of the field in the payload
+} field_t;
+const field_t SUMMARY_FIELDS[] = {
+  { 0x40, 0x11, 0 },   // leaving water temperature
+  { 0x40, 0x11, 2 },   // DHW tank temperature
+  { 0x40, 0x11, 4 },   // outside air temperature (outdoor unit)
+  { 0x40, 0x11, 6 },   // return water temperature
+  { 0x40, 0x11, 8 },   // leaving water temperature (plate heat exchanger)
+  { 0x40, 0x11, 10 },  // refrigerant temperature
+  { 0x40, 0x11, 12 },  // room temperature
+  { 0x40, 0x11, 14 },  // outside air temperature (external sensor)
+};
+const byte SUMMARY_FIELDS_CNT = sizeof(SUMMARY_FIELDS) / sizeof(SUMMARY_FIELDS[0]);
 const byte MAX_PARAM_SIZE = 6;
-const byte MAX_36_PARAMS = 0x0D;  // max number of packet type 0x36 parameters stored
+const byte MAX_36_PARAMS = 0x0D;                     // highest packet type 0x36 param number accepted, params 0x00 - MAX_36_PARAMS have reserved slots at the start of the mirror
+#ifdef ENABLE_EXTENDED_WEBUI
+const byte MAX_MIRROR_PARAMS = 128;                  // max number of params (packet types 0x35 - 0x3D) mirrored from the bus, 7 bytes of RAM each, including the reserved 0x36 slots
+#else
+const byte MAX_MIRROR_PARAMS = MAX_36_PARAMS + 1;    // only packet type 0x36 params are mirrored (SRAM is limited)
+#endif
+const byte WRITE_RESERVE = 3;                        // EEPROM write tokens reserved for urgent commands, low priority commands are deferred if no more tokens are available
+const byte PACKET_TYPE_LOW_PRIORITY = 0x36;          // Write commands of this packet type (target temperatures and setpoints) are low priority
+const byte LOW_PRIORITY_VAL_SIZE = 2;                // param value size (bytes) of PACKET_TYPE_LOW_PRIORITY commands, see PACKET_PARAM_VAL_SIZE (longer commands are not deferred)
+#ifdef ENABLE_EXTENDED_WEBUI
+const byte MAX_DEFERRED_CMDS = 4;                    // max number of deferred low priority commands (newer value of the same param replaces the deferred one)
+#else
+const byte MAX_DEFERRED_CMDS = 2;
+#endif
+const byte MAX_PENDING_CMDS = 4;                     // max number of written commands waiting for confirmation by the main controller (only used if ENABLE_EXTENDED_WEBUI)
+const byte CONFIRM_TIMEOUT = 60;                     // time in s for the new value to appear in 00Fx3x requests of the main controller, otherwise the command is retried, failed or unknown
+const byte CONFIRM_RETRIES = 1;                      // number of retries of unconfirmed commands (retries count towards the Daikin EEPROM Write Quota)
+const byte HISTORY_CHUNK = 64;                       // Max bytes of the packet history sent to the /history client per loop (slow client does not block the P1P2 bus)
+const uint16_t ERROR_BURST_GAP = 1000;               // P1P2 error packets less than this (ms) apart belong to the same error burst (ENABLE_EXTENDED_WEBUI only)
+const byte ERROR_BURSTS = 4;                         // Number of last error bursts shown on the Tools page
+const byte VOLTAGE_INTERVAL = 60;                    // Interval (seconds) of bus voltage statistics and UDP voltage record (adapters with ADC only, ENABLE_EXTENDED_WEBUI only)
+const uint16_t ADC_FULL_SCALE[2] = { 20900, 3300 };  // Voltage (mV) at full scale of ADC6 (P1/P2 bus) and ADC7 (supply) on adapters with ADC
+const uint16_t BUS_VOLTAGE_LOW = 13000;              // Interval is counted as bus voltage sag if the bus voltage (mV) drops below this threshold
+const byte SCOPE_PORT_OFFSET = 1;                    // Bus scope datagrams are sent to UDP Port + SCOPE_PORT_OFFSET (only available on Arduino Mega)
+const byte VOLTAGE_PORT_OFFSET = 2;                  // UDP voltage records are sent to UDP Port + VOLTAGE_PORT_OFFSET, not mixed with P1P2 packets (adapters with ADC only, ENABLE_EXTENDED_WEBUI only)
+const byte SUMMARY_PORT_OFFSET = 3;                  // UDP data summaries are sent to UDP Port + SUMMARY_PORT_OFFSET, not mixed with P1P2 packets (ENABLE_EXTENDED_WEBUI only)
+
+#ifdef ENABLE_EXTENDED_WEBUI
+// SRAM budget of the packet history (ENABLE_EXTENDED_WEBUI, i.e. Arduino Mega with 8 kB SRAM): whatever is left after other static data
+// (estimate: ~3.5 kB sketch globals, ~0.2 kB P1P2Serial plus 1.7 kB bus scope if ENABLE_BUS_SCOPE, ~0.3 kB Ethernet and core) and the stack reserve
+#ifdef SW_SCOPE
+const uint16_t STATIC_RAM_ESTIMATE = 5700;  // Estimated SRAM (bytes) used by static data other than the packet history, update when adding large buffers
+#else
+const uint16_t STATIC_RAM_ESTIMATE = 4000;
+#endif
+const uint16_t STACK_RESERVE = 1024;        // SRAM (bytes) kept free for the stack (web pages, nested calls, ISRs)
+const uint16_t HISTORY_SIZE = ((RAMEND + 1 - RAMSTART - STATIC_RAM_ESTIMATE - STACK_RESERVE) / 128) * 128;  // Size (bytes) of the packet history ring buffer (3072 on Mega, 1408 with bus scope), roughly 40 packets per kB
+#endif
 
 // CRC settings
 const byte CRC_GEN = 0xD9;   // Default generator/Feed for CRC check; these values work at least for the Daikin hybrid
@@ -87,12 +164,20 @@ const byte CTRL_ID[] = { 0xB4, 0x10 };  // LAN adapter ID in 0x31 payload bytes
 
 const byte MAC_START[3] = { 0x90, 0xA2, 0xDA };  // MAC range for Gheo SA
 #define ETH_RESET_PIN 7                          // Ethernet shield reset pin (deals with power on reset issue on low quality ethernet shields)
-const uint16_t ETH_RESET_DELAY = 500;            // Delay (ms) during Ethernet start, wait for Ethernet shield to start (reset issue on low quality ethernet shields)
+const uint16_t ETH_RESET_DELAY = 500;            // Delay (ms) during Ethernet start, wait for Ethernet shield to start (reset issue on low quality ethernet shields), non-blocking
 const uint16_t WEB_IDLE_TIMEOUT = 400;           // Time (ms) from last client data after which webserver TCP socket could be disconnected, non-blocking.
+const uint16_t WEB_KEEPALIVE_TIMEOUT = 5000;     // Time (ms) from last client data after which idle persistent (keep-alive) webserver TCP socket is always disconnected.
 const uint16_t TCP_DISCON_TIMEOUT = 500;         // Timeout (ms) for client DISCON socket command, non-blocking alternative to https://www.arduino.cc/reference/en/libraries/ethernet/client.setconnectiontimeout/
+const uint16_t DHCP_RESPONSE_TIMEOUT = 4000;     // Time (ms) to wait for a response from the DHCP server, non-blocking (only used if ENABLE_DHCP)
+const uint16_t DHCP_RETRY_INTERVAL = 10000;      // Interval (ms) between failed DHCP requests, fallback static IP is used meanwhile (only used if ENABLE_DHCP)
 const uint16_t TCP_RETRANSMISSION_TIMEOUT = 50;  // Ethernet controller’s timeout (ms), blocking (see https://www.arduino.cc/reference/en/libraries/ethernet/ethernet.setretransmissiontimeout/)
 const byte TCP_RETRANSMISSION_COUNT = 3;         // Number of transmission attempts the Ethernet controller will make before giving up (see https://www.arduino.cc/reference/en/libraries/ethernet/ethernet.setretransmissioncount/)
 const uint16_t FETCH_INTERVAL = 2000;            // Fetch API interval (ms) for the Modbus Status webpage to renew data from JSON served by Arduino
+const uint16_t EVENT_INTERVAL = 500;             // Interval (ms) for pushing changed status values to the event stream (only used if ENABLE_EXTENDED_WEBUI)
+const byte EVENT_MIN_FREE = 128;                 // Minimum free space (bytes) in the socket TX buffer, otherwise event is skipped (slow client does not block the P1P2 bus)
+const uint16_t LOOP_BUDGET = 2000;               // Time budget (us) of one loop() pass, periodic tasks which do not fit are postponed to the next pass (see TASKS)
 
 const byte DATA_START = 96;      // Start address where config and counters are saved in EEPROM
 const byte EEPROM_INTERVAL = 6;  // Interval (hours) for saving Modbus statistics to EEPROM (in order to minimize writes to EEPROM)
+
+#endif /* SETTINGS_FUNCTIONALITY_ONLY */
@@ -14,9 +14,11 @@
   v4.0 2025-03-09 CSS improvement, code optimization (with some help from ChatGPT), simplify P1P2 Status page,
                   target temp. hysteresis in decimals, fix 404 error page, bugfix 0x30 packet,
                   more virtual outputs in Loxone Config, rename some inputs in Loxone Config
+  v4.1 2026-10-18 Server-Sent Events, HTTP keep-alive, cacheable gzip compressed CSS and JavaScript
+  v5.0 2026-10-18 Adaptive reply delays, bus timing statistics, bus scope, Prometheus metrics
 */
 
-const byte VERSION[] = { 4, 0 };
+const byte VERSION[] = { 5, 0 };
 
 #include <SPI.h>
 #include <Ethernet.h>
@@ -33,6 +35,8 @@ const byte VERSION[] = { 4, 0 };
 #include <avr/wdt.h>
 #include <util/atomic.h>
 
+#include <util/crc16.h>  // used for detecting changes in packet payloads and in values pushed to the event stream
+
 enum first_last_t : byte {
   FIRST,
   LAST
@@ -49,6 +53,11 @@ enum mode_t : byte {
   CONTROL_AUTO     // Auto Connect
 };
 
+enum reply_delay_t : byte {
+  DELAY_FIXED,    // Fixed (F030DELAY, F03XDELAY)
+  DELAY_ADAPTIVE  // Adaptive (measured response delays of other devices)
+};
+
 // Data Packets
 enum data_packets_t : byte {
   DATA_ALWAYS,              // Always Send (~770ms cycle)
@@ -56,7 +65,15 @@ enum data_packets_t : byte {
   DATA_ONLY_CHANGE          // Only If Payload Changed
 };
 
+// Data Summary
+enum summary_t : byte {
+  SUMMARY_OFF,      // Disabled
+  SUMMARY_AND_RAW,  // Send Summary and Data Packets
+  SUMMARY_ONLY      // Send Summary Instead of Data Packets
+};
+
 #include "advanced_settings.h"
+#include "assets.h"  // static web assets (CSS, JavaScript)
 
 typedef struct {
   byte ip[4];
@@ -74,9 +91,13 @@ typedef struct {
   byte connectTimeout;
   byte hysteresis;
   byte writeQuota;
+  byte writeBurst;
+  byte replyDelay;  // only used if ENABLE_EXTENDED_WEBUI
   bool sendAllPackets;
   byte counterPeriod;
   byte sendDataPackets;
+  byte summaryMode;    // only used if ENABLE_EXTENDED_WEBUI
+  byte summaryPeriod;  // only used if ENABLE_EXTENDED_WEBUI
   byte packetStatus[PACKET_LAST][256 / 8];
 } config_t;
 
@@ -97,9 +118,13 @@ const config_t DEFAULT_CONFIG = {
   (F0THRESHOLD * 2),  // connectTimeout
   DEFAUT_TEMPERATURE_HYSTERESIS,
   DEFAULT_EEPROM_QUOTA,
+  DEFAULT_EEPROM_BURST,
+  DEFAULT_REPLY_DELAY,
   DEFAULT_SEND_ALL,
   DEFAULT_COUNTER_PERIOD,
   DEFAULT_DATA_PACKETS_MODE,  // sendDataPackets
+  DEFAULT_SUMMARY_MODE,
+  DEFAULT_SUMMARY_PERIOD,
   {}                          // packetStatus
 };
 
@@ -124,13 +149,16 @@ typedef struct {
   uint32_t invalid;    // Number of commands invalid
   uint16_t today;      // Number of commands written today
   uint16_t yesterday;  // Number of commands written yesterday
+  byte tokens;         // Number of write tokens available (token bucket, refilled at writeQuota per day up to writeBurst)
 } eeprom_t;
 
 typedef struct {
   uint32_t eepromWrites;  // Number of Arduino EEPROM write cycles
   eeprom_t eepromDaikin;
   byte major;                   // major version
+  uint16_t size;                // size of data_t, detects layout changes within a major version
   byte mac[6];                  // MAC Address (initial value is random generated)
+  byte lastAddr;                // last address used by this controller (tried first when connecting)
   config_t config;              // configuration values
   byte statsDate[6];            // Time and date when stats counter started
   uint32_t p1p2Cnt[P1P2_LAST];  // array for storing P1P2 counters
@@ -142,19 +170,58 @@ typedef struct {
 data_t data;
 
 CircularBuffer<byte, MAX_QUEUE_DATA> cmdQueue;  // queue of write commands
+byte deferredCmds[MAX_DEFERRED_CMDS][1 + 1 + 2 + LOW_PRIORITY_VAL_SIZE];  // low priority commands waiting for write tokens (cmdLen first, as in the queue), cmdLen 0 if free
 
 
 /****** ETHERNET AND P1P2 SERIAL ******/
 
 byte maxSockNum = MAX_SOCK_NUM;
+bool ethReady = false;  // ethernet interface is initiated, sockets can be used (see startEthernet)
 
 #ifdef ENABLE_DHCP
-bool dhcpSuccess = false;
+bool dhcpSuccess = false;  // IP settings are leased from the DHCP server
+
+// DHCP client states, see manageDhcp()
+enum dhcp_state_t : byte {
+  DHCP_OFF,         // DHCP disabled (static IP)
+  DHCP_INIT,        // waiting before DHCPDISCOVER is sent (fallback static IP)
+  DHCP_SELECTING,   // DHCPDISCOVER sent, waiting for DHCPOFFER
+  DHCP_REQUESTING,  // DHCPREQUEST sent, waiting for DHCPACK
+  DHCP_BOUND,       // lease obtained, waiting for renewal time (T1)
+  DHCP_RENEWING     // DHCPREQUEST sent to renew the lease, waiting for DHCPACK
+};
+// DHCP message types
+enum : byte {
+  DHCP_DISCOVER = 1,
+  DHCP_OFFER = 2,
+  DHCP_REQUEST = 3,
+  DHCP_ACK = 5,
+  DHCP_NAK = 6
+};
+const uint16_t DHCP_SERVER_PORT = 67;
+const uint16_t DHCP_CLIENT_PORT = 68;
+const uint32_t DHCP_LEASE_MAX = 2000000;  // longest lease (s) the Timer can handle, longer (or infinite) leases are renewed earlier
+byte dhcpState = DHCP_OFF;
+EthernetUDP dhcpUdp;  // DHCP client socket, open only while waiting for a response from the DHCP server
+bool dhcpNeedsSocket;  // no free socket for the DHCP client, manageSockets() frees the oldest idle web socket
+uint32_t dhcpXid;     // transaction ID of the current DHCP exchange
+byte dhcpOffer[4];    // IP address offered (leased) by the DHCP server
+byte dhcpServer[4];   // DHCP server identifier
 #endif /* ENABLE_DHCP */
 
 EthernetUDP Udp;
 EthernetServer webServer(DEFAULT_CONFIG.webPort);
 
+#ifdef ENABLE_EXTENDED_WEBUI
+byte eventSocket = MAX_SOCK_NUM;  // socket with an open Server-Sent Events stream
+bool eventPackets = false;        // stream P1P2 packets (forwarded to UDP) to the event stream
+bool eventRefresh = false;        // push all status values (not only changes) with the next event
+byte historySocket = MAX_SOCK_NUM;  // socket with a running /history download
+bool historyHex = false;            // /history download is hex encoded
+uint16_t historyPos;                // position of the next byte to send in history[]
+uint16_t historyLeft;               // bytes left to send
+#endif                              /* ENABLE_EXTENDED_WEBUI */
+
 #define SPI_CLK_PIN_VALUE (PINB & 0x20)
 
 P1P2Serial P1P2Serial;
@@ -162,6 +229,8 @@ static byte hwID = 0;
 
 /****** TIMERS AND STATE MACHINE ******/
 
+uint32_t timeNow;  // millis() read once per loop() pass, time base for all timers
+
 class Timer {
 private:
   uint32_t timestampLastHitMs;
@@ -171,14 +240,14 @@ public:
   void sleep(uint32_t sleepTimeMs);
 };
 boolean Timer::isOver() {
-  if (uint32_t(millis() - timestampLastHitMs) > sleepTimeMs) {
+  if (uint32_t(timeNow - timestampLastHitMs) > sleepTimeMs) {
     return true;
   }
   return false;
 }
 void Timer::sleep(uint32_t sleepTimeMs) {
   this->sleepTimeMs = sleepTimeMs;
-  timestampLastHitMs = millis();
+  timestampLastHitMs = timeNow;
 }
 
 Timer eepromTimer;          // timer to delay writing statistics to EEPROM
@@ -186,7 +255,23 @@ Timer connectionTimer;      // timer to monitor connection status (connection to
 Timer p1p2Timer;            // timer to monitor P1P2 messages (reading from bus)
 Timer counterRequestTimer;  // timer for 0xB8 counter requests
 Timer daikinNameTimer;      // timer for requests for Daikin indoor and outdoor unit names (1 minute)
-byte counterRequest = 0;
+Timer tokenTimer;           // timer for adding Daikin EEPROM write tokens
+Timer ethTimer;             // timer for ethernet shield reset (ETH_RESET_DELAY)
+#ifdef ENABLE_DHCP
+Timer dhcpTimer;       // timer for DHCP response timeout, retries and lease renewal (T1)
+Timer dhcpLeaseTimer;  // timer for DHCP lease expiry
+#endif                 /* ENABLE_DHCP */
+#ifdef ENABLE_EXTENDED_WEBUI
+Timer eventTimer;    // timer for pushing status changes to the event stream
+Timer summaryTimer;  // timer for sending data summary
+Timer voltageTimer;  // timer for reading ADC voltage results
+#endif             /* ENABLE_EXTENDED_WEBUI */
+byte counterSweep = 0;  // bitmask of 0xB8 counter sub-types still to be requested in the current sweep
+#ifdef ENABLE_EXTENDED_WEBUI
+uint16_t counterHash[COUNTER_SUBTYPES];  // CRC16 of the last counter response of each sub-type
+byte counterSame[COUNTER_SUBTYPES];      // number of consecutive unchanged counter responses of each sub-type
+byte counterSweeps;                      // number of regular counter sweeps
+#endif                                   /* ENABLE_EXTENDED_WEBUI */
 byte div2 = 0;
 
 enum state : byte {
@@ -212,10 +297,61 @@ byte controllerAddr = DISCONNECTED;
 */
 static int8_t FxRequests[16];
 
+#ifdef ENABLE_EXTENDED_WEBUI
+enum adc_t : byte {
+  ADC_BUS,     // ADC6, P1/P2 bus voltage
+  ADC_SUPPLY,  // ADC7, supply voltage
+  ADC_LAST     // Number of status flags in this enum. Must be the last element within this enum!!
+};
+typedef struct {
+  uint16_t last[3];  // min, avg and max (mV) in the last interval
+  uint16_t min;      // min (mV) since stats reset
+  uint16_t max;      // max (mV) since stats reset
+} voltage_t;
+voltage_t voltage[ADC_LAST];       // voltages measured by adapters with ADC (hwID 1)
+uint16_t sagCnt;                   // number of intervals with bus voltage below BUS_VOLTAGE_LOW
+uint32_t sagErrors;                // P1P2 read and write errors during these intervals
+byte voltageSeq;                   // sequence number of the voltage record
+const byte VOLTAGE_MARKER = 0x56;  // first byte of the voltage record
+uint32_t connectStart;  // millis() when the controller started connecting
+uint32_t connectTime;   // time (ms) from the start of connecting to getting an address, 0 if never connected
+#endif                  /* ENABLE_EXTENDED_WEBUI */
+
 /****** RUN TIME AND DATA COUNTERS ******/
 
 byte savedPackets[SAVED_PACKETS_SIZE] = {};
-byte saved36Params[MAX_36_PARAMS + 1][2];  // storage for 0x36 parameters, param value is s16 (2 bytes)
+#ifdef ENABLE_EXTENDED_WEBUI
+byte payloadSize[2][DATA_PACKETS_CNT];  // payload sizes of data packets (initial or learned from the bus)
+byte learnedSizes[2];                   // bitmask of data packet payload sizes learned from the bus
+typedef struct {
+  byte key[4];    // packet header (source, destination, packet type) and sub-type (0 for packet types without sub-type)
+  byte stamp;     // last use (for LRU eviction), 0 if slot is free
+  uint16_t hash;  // CRC16 of the payload (including length)
+} cache_t;
+cache_t packetCache[PACKET_CACHE_SIZE];  // payload hashes of other (non-data) packets
+byte cacheClock;                         // incremented with every cache lookup
+#endif /* ENABLE_EXTENDED_WEBUI */
+typedef struct {
+  byte type;      // packet type (0x35 - 0x3D), 0 if slot is free
+  byte param[2];  // param number (little endian, as on the bus)
+#ifdef ENABLE_EXTENDED_WEBUI
+  byte val[4];  // param value (PACKET_PARAM_VAL_SIZE bytes, as on the bus)
+#else
+  byte val[2];  // only packet type 0x36 params (2 bytes) are mirrored
+#endif
+} param_t;
+param_t mirror[MAX_MIRROR_PARAMS];  // field settings seen in 00Fx35 - 00Fx3D requests of the main controller
+#ifdef ENABLE_EXTENDED_WEBUI
+typedef struct {
+  int16_t min;     // f8.8
+  int16_t max;     // f8.8
+  int32_t sum;     // sum of f8.8 values
+  uint16_t count;  // number of values
+} stats_t;
+stats_t summary[SUMMARY_FIELDS_CNT];  // min, max and mean of SUMMARY_FIELDS in the current period
+byte summarySeq;                      // sequence number of the summary datagram
+const byte SUMMARY_MARKER = 0x41;     // first byte of the summary datagram
+#endif                                /* ENABLE_EXTENDED_WEBUI */
 const byte PACKET_TYPE_HANDSHAKE = PACKET_TYPE_CONTROL[FIRST];
 
 const byte NAME_SIZE = 16;  // buffer size for device name
@@ -231,68 +367,238 @@ uint32_t seed2 = 17111989;  // seed2 is static
 
 byte date[6];  // Date and time from Daikin Unit
 
+// Loop stages (periodic tasks are also stages), durations are measured by the loop latency profiler (only used if ENABLE_EXTENDED_WEBUI)
+enum stage_t : byte {
+  STAGE_BUS,         // recvBus()
+  STAGE_UDP,         // recvUdp()
+  STAGE_WEB,         // manageSockets()
+  STAGE_CONTROLLER,  // taskController()
+  STAGE_EEPROM,      // taskEeprom()
+  STAGE_DHCP,        // manageDhcp()
+  STAGE_MAINTAIN,    // taskMaintain()
+  STAGE_LOOP,        // whole loop() pass
+  STAGE_LAST         // Number of stages in this enum. Must be the last element within this enum!!
+};
+
 #ifdef ENABLE_EXTENDED_WEBUI
+// Boot timeline, time (ms) since start at which each stage was reached
+enum boot_t : byte {
+  BOOT_CONFIG,    // configuration loaded from EEPROM
+  BOOT_ETHERNET,  // ethernet interface initiated
+  BOOT_BUS,       // P1P2 bus receiver started
+  BOOT_PACKET,    // first P1P2 packet received
+  BOOT_DHCP,      // first DHCP lease obtained
+  BOOT_LAST       // Number of stages in this enum. Must be the last element within this enum!!
+};
+uint32_t bootTime[BOOT_LAST];
+byte bootDone = 0;  // bitmask of boot stages already reached
+
 // store uptime seconds (includes seconds counted before millis() overflow)
 uint32_t seconds;
 // store last millis() so that we can detect millis() overflow
 uint32_t last_milliseconds = 0;
 // store seconds passed until the moment of the overflow so that we can add them to "seconds" on the next call
 int32_t remaining_seconds;
+
+const byte LATENCY_BUCKETS = 12;  // log2 histogram: bucket 0 is < 64 us, bucket 1 is < 128 us, ..., last bucket is >= 65 ms
+typedef struct {
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;  // sum of all durations (us), 64 bits as the whole loop() alone adds up to 1 s every second
+  uint32_t hist[LATENCY_BUCKETS];
+} latency_t;
+latency_t latency[STAGE_LAST];
+byte slowStage = STAGE_LOOP;  // the slowest stage of the previous loop() pass
+
+// Replies to 00Fx3x requests addressed to this controller
+enum reply_t : byte {
+  REPLY_REQUESTS,  // Requests addressed to this controller
+  REPLY_ON_TIME,   // Reply read back from the bus right after the request
+  REPLY_LATE,      // Reply scheduled after the response delay already passed
+  REPLY_SKIPPED,   // No reply, previous write still pending (writeready() false)
+  REPLY_MISSED,    // Reply scheduled on time, but not read back from the bus
+  REPLY_LAST       // Number of counters in this enum. Must be the last element within this enum!!
+};
+const byte LAG_BUCKETS = 9;  // log2 histogram: bucket 0 is 0 ms, bucket 1 is 1 ms, bucket 2 is 2-3 ms, ..., last bucket is >= 128 ms
+uint32_t replyCnt[REPLY_LAST];
+uint32_t replyLag[LAG_BUCKETS];        // time (ms) between the request and the moment the reply was scheduled for writing
+uint32_t replyLagSum;                 // sum of all reply lags (ms)
+uint32_t replyLateStage[STAGE_LAST];  // late replies by the slowest loop stage before the reply was scheduled
+byte replyPending[3];                 // header of the reply waiting to be read back from the bus (replyPending[0] == 0xFF if none)
+
+// Bus timing statistics (pause before each packet is measured by P1P2Serial, see readpacket() delta)
+const byte TIMING_CONTROL = DATA_PACKETS_CNT;     // responseDelay[] row for control packets (0x30 - 0x3E), rows 0 - 6 are data packets (0x10 - 0x16)
+const byte TIMING_OTHER = DATA_PACKETS_CNT + 1;   // responseDelay[] row for other packet types
+const byte TIMING_LAST = DATA_PACKETS_CNT + 2;    // Number of rows in responseDelay[]
+const uint32_t BUS_WINDOW = 30UL * 60UL * 1000UL;  // bus idle time is calculated over the last ~30 minutes (ms)
+uint32_t responseDelay[TIMING_LAST][LAG_BUCKETS];  // time (ms) between the request and the response of other devices
+uint32_t responseDelaySum[TIMING_LAST];            // sum of all response delays (ms)
+byte lastRequest[3];                               // header of the last request read from the bus
+uint32_t cycleStart;                               // millis() of the last 000010 request
+uint16_t cycle[3];                                 // duration (ms) of the data packets cycle (between two 000010 requests): last, min, max
+uint32_t busBits;                                  // bits transmitted on the bus since busStart
+uint32_t busStart;                                 // millis() when bus idle time measurement started
+
+// P1P2 errors by error class and packet type
+enum error_class_t : byte {
+  ERR_CLASS_SB,   // start bit error during write
+  ERR_CLASS_BE,   // data read-back error (collision)
+  ERR_CLASS_BC,   // high bit half read-back error (collision)
+  ERR_CLASS_PE,   // parity error (electrical)
+  ERR_CLASS_OR,   // read buffer overrun (main loop too slow)
+  ERR_CLASS_CRC,  // CRC error
+  ERR_CLASS_LAST  // Number of error classes in this enum. Must be the last element within this enum!!
+};
+const byte ERROR_CLASS_FLAG[ERR_CLASS_LAST] = { ERROR_SB, ERROR_BE, ERROR_BC, ERROR_PE, ERROR_OR, ERROR_CRC };
+uint16_t errorMatrix[TIMING_LAST][ERR_CLASS_LAST];  // packets with errors by packet type (same rows as responseDelay[]) and error class
+typedef struct {
+  uint32_t start;        // millis() of the first error packet
+  uint16_t cycleOffset;  // time (ms) since the start of the data packets cycle (000010 request), 0xFFFF if unknown
+  byte packets;          // number of error packets in the burst
+  byte flags;            // error flags of all packets in the burst
+} burst_t;
+burst_t bursts[ERROR_BURSTS];  // last error bursts (ring buffer)
+byte burstIdx;                 // newest burst in bursts[]
+uint32_t lastErrorTime;        // millis() of the last error packet
+
+// Packet history ring buffer, each entry: length, error flags, varint ms since the previous entry, varint pause before the packet, packet
+byte history[HISTORY_SIZE];
+uint16_t historyTail;     // position of the oldest entry
+uint16_t historyUsed;     // bytes used
+uint16_t historyCnt;      // number of entries
+uint32_t historyFirst;    // millis() of the oldest entry
+uint32_t historyLast;     // millis() of the newest entry
+uint16_t historyDropped;  // packets not recorded because the ring was locked by a download
+
+// Adaptive reply delays (data.config.replyDelay == DELAY_ADAPTIVE), index 0 is for 0x30 replies, index 1 for 0x31 - 0x3E replies
+byte otherDelay[2];   // longest response delay (ms) of other auxiliary controllers to 00Fx3x requests
+byte delayBackoff;    // time (ms) added to adaptive delays after collisions (ERROR_BC, ERROR_BE)
+byte backoffCnt;      // replies on time since the last backoff decrement
+
+// Confirmation of written commands (the new value must appear in 00Fx3x requests of the main controller)
+enum confirm_t : byte {
+  CONFIRM_OK,       // New value seen in requests of the main controller
+  CONFIRM_RETRIED,  // Command written again after timeout
+  CONFIRM_FAILED,   // Other value seen after all retries
+  CONFIRM_UNKNOWN,  // Param not seen in requests of the main controller since the command was written, not retried
+  CONFIRM_LAST      // Number of counters in this enum. Must be the last element within this enum!!
+};
+typedef struct {
+  byte cmd[1 + 2 + MAX_PARAM_SIZE];  // packet type, param number, param value (same as in the queue), cmd[0] == 0 if slot is free
+  byte len;                          // command length
+  byte retries;                      // number of retries
+  bool seen;                         // param seen with another value in 00Fx3x requests since the command was written
+  uint32_t sent;                     // millis() when the command was written
+} pendingCmd_t;
+pendingCmd_t pendingCmds[MAX_PENDING_CMDS];
+uint32_t confirmCnt[CONFIRM_LAST];
+uint32_t confirmTime[3];  // time (ms) between writing a command and its confirmation: last, min, max
+
+#ifdef MEASURE_LOAD
+// time spent in P1P2Serial timer ISRs during packets, relative to packet time, not wall-clock time (rolling sums, halved when lapsed time reaches LOAD_WINDOW)
+enum load_t : byte {
+  LOAD_READ,
+  LOAD_WRITE,
+  LOAD_LAST
+};
+const uint32_t LOAD_WINDOW = 0x01000000;  // ~16.8 s of packet time on the bus (us)
+const uint16_t BIT_TIME_X10 = 1042;       // duration of 10 bits (us) at 9600 baud
+typedef struct {
+  uint32_t isr;     // time spent in ISRs (us)
+  uint32_t lapsed;  // duration of packets (us)
+  uint16_t peak;    // peak ISR time per bit (0.1 us)
+} busLoad_t;
+busLoad_t busLoad[LOAD_LAST];
+#endif /* MEASURE_LOAD */
+
+#ifdef SW_SCOPE
+// bus scope: edge timing of each packet (logged by P1P2Serial ISRs) is sent as a binary UDP datagram
+const byte SCOPE_MARKER = 0x53;  // first byte of the scope datagram
+const byte SCOPE_CHUNK = 16;     // scope events written to the UDP buffer at once (3 bytes/event, on stack)
+bool scopeEnabled = false;
+byte scopeSeq;  // scope datagram sequence number
+#endif /* SW_SCOPE */
+#define PROFILE(stage) stageStart = profile(stage, stageStart)
+#else
+#define PROFILE(stage)
 #endif /* ENABLE_EXTENDED_WEBUI */
 
 /****** SETUP: RUNS ONCE ******/
 
 void setup() {
-  CreateTrulyRandomSeed();
+  CreateTrulyRandomSeed();  // non-blocking, seed is only needed for MAC generation
+
   EEPROM.get(DATA_START, data);
-  // is configuration already stored in EEPROM?
-  if (data.major != VERSION[0]) {
+  // is configuration already stored in EEPROM (with the same layout)?
+  if (data.major != VERSION[0] || data.size != sizeof(data_t)) {
     data.major = VERSION[0];
+    data.size = sizeof(data_t);
     // load default configuration from flash memory
     data.config = DEFAULT_CONFIG;
+    data.eepromDaikin.tokens = data.config.writeBurst;
     // Send data packets (0x10-0x16) and counter packet (0xB8) by default
     setPacketStatus(PACKET_TYPE_COUNTER, PACKET_SENT, true);
     for (byte i = PACKET_TYPE_DATA[FIRST]; i <= PACKET_TYPE_DATA[LAST]; i++) {
       setPacketStatus(i, PACKET_SENT, true);
     }
     generateMac();  // generate new MAC (bytes 0, 1 and 2 are static, bytes 3, 4 and 5 are generated randomly)
+    data.lastAddr = DISCONNECTED;
     resetStats();   // resets all counters to 0
     updateEeprom();
   }
-  startEthernet();
+#ifdef ENABLE_EXTENDED_WEBUI
+  bootStage(BOOT_CONFIG);
+#endif /* ENABLE_EXTENDED_WEBUI */
 
-  memset(savedPackets, 0xFF, sizeof(savedPackets));  // initial value for all saved packets is 0xFF
+  // Ethernet is initiated before the P1P2 bus receiver: the first W5x00 init in the Ethernet library blocks for 560 ms
+  // (longer than ETH_RESET_DELAY, so it also covers the shield reset), a running receiver would overrun its buffer meanwhile
+  startEthernet();  // shield reset pulse
+  beginEthernet();
 
-  hwID = SPI_CLK_PIN_VALUE ? 0 : 1;
+  hwID = SPI_CLK_PIN_VALUE ? 0 : 1;                   // read with SPI initiated by the Ethernet library
   P1P2Serial.begin(9600, hwID ? true : false, 6, 7);  // if hwID = 1, use ADC6 and ADC7
   P1P2Serial.setEcho(true);                           // defines whether written data is read back and verified against written data (advise to keep this 1)
   P1P2Serial.setDelayTimeout(INIT_SDTO);
+#ifdef ENABLE_EXTENDED_WEBUI
+  bootStage(BOOT_BUS);
+#endif /* ENABLE_EXTENDED_WEBUI */
 
+#ifdef ENABLE_EXTENDED_WEBUI
+  memcpy(payloadSize, PACKET_PAYLOAD_SIZE, sizeof(payloadSize));
+#endif /* ENABLE_EXTENDED_WEBUI */
+  clearSavedPackets();
+
+  timeNow = millis();
   connectionTimer.sleep(data.config.connectTimeout * 1000UL);
   eepromTimer.sleep(EEPROM_INTERVAL * 60UL * 60UL * 1000UL);  // EEPROM_INTERVAL is in hours, sleep is in milliseconds!
+  if (data.config.writeQuota) tokenTimer.sleep(24UL * 60UL * 60UL * 1000UL / data.config.writeQuota);  // no free token after reboot
+#ifdef ENABLE_EXTENDED_WEBUI
+  resetLatency();
+  replyPending[0] = 0xFF;
+#endif /* ENABLE_EXTENDED_WEBUI */
 }
 
 void loop() {
+  timeNow = millis();
+  uint32_t loopStart = micros();
+#ifdef ENABLE_EXTENDED_WEBUI
+  uint32_t stageStart = loopStart;
+#endif /* ENABLE_EXTENDED_WEBUI */
 
   recvBus();
-  recvUdp();
-  manageSockets();
-
-  manageController();
-
-  if (rollover()) {
-    resetStats();
-    updateEeprom();
+  PROFILE(STAGE_BUS);
+  if (ethReady) {
+    recvUdp();
+    PROFILE(STAGE_UDP);
+    manageSockets();
+    PROFILE(STAGE_WEB);
+  } else if (ethTimer.isOver()) {
+    beginEthernet();
   }
 
-  if (EEPROM_INTERVAL > 0 && eepromTimer.isOver() == true) {
-    updateEeprom();
-  }
+  runTasks(loopStart);
 
 #ifdef ENABLE_EXTENDED_WEBUI
-  maintainUptime();  // maintain uptime in case of millis() overflow
-#endif               /* ENABLE_EXTENDED_WEBUI */
-#ifdef ENABLE_DHCP
-  Ethernet.maintain();
-#endif /* ENABLE_DHCP */
+  profile(STAGE_LOOP, loopStart);
+#endif /* ENABLE_EXTENDED_WEBUI */
 }
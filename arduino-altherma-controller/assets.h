@@ -0,0 +1,117 @@
+/* Static web assets served by the web server: stylesheet (s.css) and JavaScript (s.js).
+
+  Assets are stored gzip-compressed in flash memory and sent as they are (Content-Encoding: gzip).
+  The uncompressed source is in the comment above each array. If you edit the source,
+  remove new lines, compress it (gzip -9 -n) and convert to C array (xxd -i).
+
+  HTML Tags
+    h1 - main title of the page
+    h4 - text in navigation menu and header of page content
+    a - items in left navigation menu
+    label - first cell of a row in content
+  CSS Classes
+    w - wrapper (includes m + c)
+    m  - navigation menu (left)
+    c - wrapper for the content of a page (incl. smaller header and main)
+    q - row inside a content (default: top-aligned)
+    r - row inside a content (adds: center-aligned)
+    i - short input (byte or IP address octet)
+    n - input type=number
+    s - select input with numbers
+    p - inputs disabled by id=o checkbox
+    v - parameter value inputs
+  CSS Ids
+    o - checkbox which disables other checkboxes and inputs
+    t - packet type select (option attribute data-n is the number of parameter values)
+  JavaScript Functions
+    g(h) - disable (h = true) or enable inputs with class p
+    b(t) - fetch d.json every t ms and update elements by id
+    s() - update elements by id from the event stream
+*/
+
+/*
+  *{box-sizing:border-box}
+  body{padding:1px;margin:0;font-family:sans-serif;height:100vh}
+  body,.w,.c,.q{display:flex}
+  body,.c{flex-flow:column}
+  .w{flex-grow:1;min-height:0}
+  .m{flex:0 0 20vw}
+  .c{flex:1}
+  .m,main{overflow:auto;padding:15px}
+  .m,.q{padding:1px}
+  .r{align-items:center}
+  h1,h4{padding:10px}
+  h1,.m,h4{background:#0067AC;margin:1px}
+  a,h1,h4{color:white;text-decoration:none}
+  .c h4{padding-left:30%}
+  label{width:30%;text-align:right;margin-right:2px}
+  .s{text-align:right}
+  .s>option{direction:rtl}
+  .i,.v{text-align:center;width:4ch;color:black}
+  .n{width:10ch}
+  .v{display:none}
+*/
+const byte ASSET_CSS[] PROGMEM = {
+  0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x5D, 0x51, 0xED, 0x4E, 0xC3, 0x20,
+  0x14, 0x7D, 0x95, 0x25, 0xC6, 0x3F, 0xA6, 0x10, 0x3A, 0xA7, 0x26, 0x90, 0x98, 0x18, 0x9F, 0x84,
+  0x02, 0x2D, 0x44, 0x0A, 0x95, 0xB2, 0xB6, 0x93, 0xF0, 0xEE, 0x5E, 0xDA, 0xCE, 0x2D, 0xFE, 0xBC,
+  0x87, 0x73, 0xCF, 0xC7, 0xE5, 0x29, 0x35, 0x7E, 0x41, 0xA3, 0xF9, 0x31, 0xAE, 0xA3, 0x8D, 0x0F,
+  0x52, 0x05, 0x04, 0x48, 0x6E, 0xBC, 0xBC, 0xA4, 0x81, 0x4B, 0x59, 0xF0, 0x7A, 0x58, 0x58, 0xCF,
+  0x43, 0x67, 0x1C, 0x25, 0xAC, 0xF5, 0x2E, 0xA2, 0x96, 0xF7, 0xC6, 0x5E, 0xE8, 0xC8, 0xDD, 0x88,
+  0x46, 0x15, 0x4C, 0xCB, 0xB4, 0x32, 0x9D, 0x8E, 0xB4, 0x26, 0x64, 0xD2, 0xEB, 0x76, 0x85, 0xE7,
+  0x0A, 0x8B, 0x0A, 0x7F, 0x27, 0x69, 0xC6, 0xC1, 0xF2, 0x0B, 0x6D, 0xAD, 0x5A, 0xF6, 0x27, 0x91,
+  0xCA, 0x80, 0x5A, 0xEB, 0x67, 0x2A, 0xBC, 0x3D, 0xF7, 0x2E, 0xE3, 0x79, 0xC3, 0xBA, 0x00, 0x58,
+  0xCD, 0x7A, 0xE3, 0xD0, 0xAE, 0x49, 0x32, 0xEE, 0xD7, 0x37, 0x4A, 0x0E, 0xE4, 0x70, 0x24, 0xD3,
+  0x9C, 0x77, 0x01, 0x5A, 0xC3, 0x53, 0xD5, 0x73, 0xE3, 0x92, 0x9F, 0x54, 0x58, 0xE5, 0xF8, 0x39,
+  0x7A, 0xF6, 0x97, 0xFC, 0x65, 0x58, 0x0A, 0x05, 0x52, 0xDC, 0x95, 0xC9, 0x38, 0x24, 0x6E, 0x4D,
+  0xE7, 0x90, 0x89, 0xAA, 0x1F, 0xA9, 0x50, 0x2E, 0xAA, 0x90, 0x75, 0x5D, 0xE9, 0xD3, 0x8D, 0x47,
+  0x80, 0x08, 0x10, 0x6C, 0x03, 0xDA, 0x70, 0xF1, 0x05, 0xC9, 0xCE, 0x4E, 0xD2, 0x07, 0x42, 0x5E,
+  0xDF, 0x3E, 0x3E, 0xAF, 0x17, 0x29, 0x7A, 0xBC, 0xDA, 0x76, 0xA1, 0x8A, 0x0F, 0x74, 0xD6, 0x20,
+  0xCB, 0xA2, 0x5A, 0x22, 0x92, 0x4A, 0xF8, 0xC0, 0xA3, 0xF1, 0x8E, 0x3A, 0xEF, 0x14, 0xE4, 0x3E,
+  0xDC, 0x2C, 0x90, 0x55, 0x6D, 0xA4, 0xCF, 0xE4, 0x31, 0x5B, 0xDE, 0x28, 0x9B, 0x66, 0x23, 0xA3,
+  0x2E, 0xF3, 0xB6, 0xBB, 0x26, 0xA4, 0xA1, 0x9C, 0x60, 0xF7, 0x42, 0xEB, 0x40, 0x8F, 0xA5, 0xC1,
+  0x98, 0xFE, 0x93, 0x00, 0x7B, 0xF7, 0x43, 0xF1, 0x82, 0x8B, 0x07, 0x25, 0x56, 0xD7, 0x10, 0x6D,
+  0xC6, 0xA6, 0xC2, 0xD3, 0x3D, 0x7D, 0xEB, 0xCB, 0x36, 0xBF, 0x93, 0xD0, 0x6C, 0xCB, 0xDD, 0x58,
+  0x28, 0x99, 0xB1, 0xDB, 0x83, 0xD4, 0x44, 0xE8, 0x0C, 0x8B, 0xD7, 0xEF, 0x5B, 0x0B, 0xFC, 0x02,
+  0xBA, 0x99, 0x7D, 0x79, 0x30, 0x02, 0x00, 0x00,
+};
+
+/*
+  var a;
+  function g(h){for(const x of document.getElementsByClassName('p'))x.disabled=h}
+  function h(f){for(var i in f){const e=document.getElementById(i);if(e)e.innerHTML=f[i]}}
+  function c(){if(!a){alert('Connnection lost');a=1}}
+  function b(t){setInterval(()=>fetch('d.json').then(e=>e.json()).then(f=>{a=0;h(f)}).catch(c),t)}
+  function s(){const e=new EventSource('events');e.onmessage=m=>h(JSON.parse(m.data));e.onopen=()=>{a=0};e.onerror=c}
+  window.onload=()=>{const o=document.getElementById('o');if(o)g(o.checked);const t=document.getElementById('t');if(t){const u=()=>{const n=t.selectedOptions[0].dataset.n;document.querySelectorAll('.v').forEach(f=>{const v=f.id[1]<=n;f.style.display=v?'inline':'none';f.required=v})};t.onchange=u;u()}}
+*/
+const byte ASSET_JS[] PROGMEM = {
+  0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x75, 0x92, 0x41, 0x6F, 0xDC, 0x20,
+  0x10, 0x85, 0xFF, 0x8A, 0x7B, 0x82, 0x91, 0x2A, 0x94, 0x5C, 0xEB, 0xB2, 0x55, 0x13, 0xAD, 0xD4,
+  0x54, 0x6D, 0x72, 0xD8, 0xDE, 0x56, 0x7B, 0x20, 0x30, 0xAC, 0x49, 0xF0, 0xE0, 0x00, 0xF6, 0xC6,
+  0x5A, 0xF9, 0xBF, 0x17, 0xAF, 0x9B, 0xDD, 0x1C, 0x9A, 0x1B, 0x0C, 0xEF, 0xBD, 0x61, 0x3E, 0xCD,
+  0xA0, 0x62, 0xA5, 0x6A, 0xDB, 0x93, 0xCE, 0x2E, 0x50, 0xB5, 0xE7, 0x0D, 0x1C, 0x6D, 0x88, 0x5C,
+  0x07, 0x4A, 0xB9, 0x7A, 0xAD, 0x82, 0xAD, 0x4C, 0xD0, 0x7D, 0x8B, 0x94, 0xC5, 0x1E, 0xF3, 0xDA,
+  0xE3, 0x7C, 0x4C, 0x37, 0xE3, 0xAD, 0x57, 0x29, 0xDD, 0xAB, 0x16, 0x39, 0xEB, 0x18, 0xC0, 0xAB,
+  0x30, 0x2E, 0xA9, 0x47, 0x8F, 0x46, 0x36, 0xD3, 0x39, 0xAE, 0xE1, 0x76, 0x89, 0x1B, 0x4A, 0x1B,
+  0x57, 0x39, 0xAA, 0xCA, 0x7D, 0x89, 0x46, 0xF9, 0x9F, 0xDC, 0x9B, 0xF1, 0xCE, 0x70, 0x07, 0xB5,
+  0xB3, 0x1C, 0x01, 0x85, 0x23, 0xC2, 0xF8, 0xE3, 0xCF, 0xEF, 0x5F, 0xD2, 0x6E, 0xDD, 0x6E, 0xBA,
+  0xE4, 0x6A, 0x0E, 0xC7, 0xA2, 0xF9, 0xA4, 0xE0, 0xA8, 0x3C, 0xC6, 0xCC, 0xD9, 0x6D, 0xA0, 0x22,
+  0x5E, 0x5E, 0x7D, 0x48, 0x99, 0x41, 0xAD, 0xE4, 0xF5, 0x3B, 0xCB, 0x23, 0xCF, 0x70, 0x4C, 0x98,
+  0xEF, 0x28, 0x63, 0x1C, 0x94, 0xE7, 0x1C, 0xE4, 0xCA, 0x62, 0xD6, 0x0D, 0x67, 0x46, 0x3C, 0xA5,
+  0x40, 0x0C, 0x44, 0x6E, 0x90, 0x38, 0xCA, 0x15, 0x9E, 0x0A, 0x1C, 0xFE, 0x55, 0xAC, 0x5C, 0x1D,
+  0x95, 0xBC, 0xAA, 0xE7, 0x71, 0x26, 0x10, 0x5A, 0xCD, 0x2E, 0x0D, 0x9F, 0x33, 0x5C, 0xF2, 0x13,
+  0xBF, 0x4C, 0x46, 0x78, 0xA8, 0xD6, 0x43, 0x99, 0x67, 0x13, 0xFA, 0xA8, 0x0B, 0x21, 0x9C, 0x2F,
+  0xA9, 0xFC, 0x09, 0x45, 0xA0, 0x16, 0x53, 0x52, 0x7B, 0x94, 0xAD, 0x5C, 0x35, 0xFC, 0xE7, 0xE6,
+  0xE1, 0x5E, 0x74, 0x2A, 0x26, 0xE4, 0xAD, 0x30, 0x2A, 0x2B, 0x58, 0x44, 0xA1, 0x43, 0x92, 0xF3,
+  0x17, 0xE7, 0xC6, 0xD3, 0xA9, 0x84, 0x31, 0x86, 0x28, 0xF5, 0x74, 0x70, 0x64, 0xC2, 0xA1, 0x14,
+  0x7C, 0x50, 0x66, 0xD1, 0x2C, 0x8D, 0xC3, 0x87, 0x48, 0x59, 0x60, 0x27, 0xA8, 0x01, 0xF6, 0x3C,
+  0x08, 0xDD, 0xA0, 0x7E, 0x46, 0x03, 0xF5, 0x62, 0xCB, 0x1F, 0xDB, 0xF2, 0x62, 0xCB, 0x6F, 0xA3,
+  0xF5, 0xEF, 0xDB, 0x91, 0xCC, 0x22, 0xA1, 0x2F, 0xD0, 0xD1, 0x3C, 0x74, 0x33, 0x84, 0xB4, 0xBD,
+  0xDA, 0x9D, 0x86, 0x28, 0x9C, 0x05, 0xD5, 0xE7, 0xD8, 0x97, 0x1E, 0xE3, 0xB8, 0x39, 0x49, 0x43,
+  0xFC, 0xEE, 0x3D, 0x67, 0x62, 0x28, 0xB4, 0xCB, 0x62, 0xAC, 0x55, 0x21, 0x69, 0xCF, 0x91, 0x83,
+  0xB4, 0xC2, 0x99, 0xED, 0xF5, 0xEE, 0xAB, 0xA4, 0xDA, 0x8A, 0x94, 0x47, 0x8F, 0xF3, 0x62, 0x75,
+  0x5E, 0x8D, 0x72, 0xF8, 0xC6, 0x1C, 0x79, 0x47, 0xC8, 0xBE, 0x30, 0x2A, 0x38, 0x58, 0x51, 0x44,
+  0x7C, 0xE9, 0x5D, 0x2C, 0x4B, 0x37, 0x4C, 0x30, 0xD5, 0xB9, 0x40, 0xD1, 0x8D, 0xA2, 0x02, 0xB7,
+  0xAF, 0x7B, 0x0E, 0xD3, 0xF4, 0x17, 0x8E, 0xC2, 0x7E, 0x4F, 0xDF, 0x02, 0x00, 0x00,
+};
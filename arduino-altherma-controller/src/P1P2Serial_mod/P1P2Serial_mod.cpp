@@ -230,23 +230,38 @@ bool fakeError(byte x)
 #ifdef MEASURE_LOAD
 
 // CLOCK msg 32 bytes ca 33ms 33000 us so irq_time is 16-bit counter 1us resolution, irq_lapsed is also 1us resolution
-// TIMER1 runs at 8 MHZ / at 64 kB overflows every 8ms.
-// if ISR does not take longer than 64k/8 = 8us,
+// RW timer (TIMER1, TIMER5 on ATmega2560) runs at F_CPU without prescaler, at 64k it overflows every 4ms (16MHz) or 8ms (8MHz).
+// IRQ_SHIFT converts timer ticks to us.
 
 volatile uint16_t irq_start_time = 0, irq_start = 0, irq_w = 0, irq_r = 0, irq_time = 0, irq_lapsed_w = 0, irq_lapsed_r = 0;
 volatile uint8_t irq_ovf = 0, irq_busy = 0;
-// assume 8MHz: TODO >> 3 or >> 4
-//
-#define IRQ_START { irq_start_time = GET_TIMER_W_COUNT(); }
-#define IRQ_STOP  { irq_time += (GET_TIMER_W_COUNT() - irq_start_time) >> 3; }
-#define IRQ_BEGIN { irq_time = 0; irq_start = GET_TIMER_W_COUNT(); irq_ovf = 0; TIFR1 = (1 << TOV1); irq_busy = 1; };
-#define IRQ_END_R { irq_r = irq_time;  irq_w = 0; irq_lapsed_r = ((GET_TIMER_W_COUNT() - irq_start) >> 3) + ((irq_ovf + ((TIFR1 & (1 << TOV1)) ? 1 : 0)) << 13); irq_busy = 0; };
-#define IRQ_END_W { irq_w = irq_time;  irq_r = 0; irq_lapsed_w = ((GET_TIMER_W_COUNT() - irq_start) >> 3) + ((irq_ovf + ((TIFR1 & (1 << TOV1)) ? 1 : 0)) << 13); irq_busy = 0; };
 
-// (share range range = 0 .. 255, perhaps even 256?)
+#if F_CPU == 16000000L
+#define IRQ_SHIFT 4
+#else /* F_CPU */
+#define IRQ_SHIFT 3
+#endif /* F_CPU */
 
+#ifdef __AVR_ATmega2560__
+#define OVF_vect                        TIMER5_OVF_vect
+#define OVF_FLAG()                      (TIFR5 & (1 << TOV5))
+#define CLEAR_OVF_FLAG()                (TIFR5 = (1 << TOV5))
+#define ENABLE_OVF                      (TIFR5 = (1 << TOV5), TIMSK5 |= (1 << TOIE5))
+#else /* __AVR_ATmega2560__ */
 #define OVF_vect                        TIMER1_OVF_vect
+#define OVF_FLAG()                      (TIFR1 & (1 << TOV1))
+#define CLEAR_OVF_FLAG()                (TIFR1 = (1 << TOV1))
 #define ENABLE_OVF                      (TIFR1 = (1 << TOV1), TIMSK1 |= (1 << TOIE1))
+#endif /* __AVR_ATmega2560__ */
+
+// elapsed time counts overflows, so the difference of the timer values must not be truncated to uint16_t
+#define IRQ_LAPSED ((((uint32_t)(irq_ovf + (OVF_FLAG() ? 1 : 0)) << 16) + GET_TIMER_W_COUNT() - irq_start) >> IRQ_SHIFT)
+
+#define IRQ_START { irq_start_time = GET_TIMER_W_COUNT(); }
+#define IRQ_STOP  { irq_time += (uint16_t)(GET_TIMER_W_COUNT() - irq_start_time) >> IRQ_SHIFT; }
+#define IRQ_BEGIN { irq_time = 0; irq_start = GET_TIMER_W_COUNT(); irq_ovf = 0; CLEAR_OVF_FLAG(); irq_busy = 1; };
+#define IRQ_END_R { irq_r = irq_time;  irq_w = 0; irq_lapsed_r = IRQ_LAPSED; irq_busy = 0; };
+#define IRQ_END_W { irq_w = irq_time;  irq_r = 0; irq_lapsed_w = IRQ_LAPSED; irq_busy = 0; };
 
 
 #else /* MEASURE_LOAD */
@@ -435,6 +450,12 @@ void P1P2Serial::begin(uint32_t baud, bool use_ADC /* = false */, uint8_t ADC_pi
   tx_buffer_head = 0;
   tx_buffer_tail = 0;
   tx_wait = 0;
+#ifdef SW_SCOPE
+  // both banks start empty, otherwise the first log would be handed over as a full (wrapped) log
+  sws_cnt = 0;
+  sws_event[0][SWS_MAX - 1] = SWS_EVENT_LOOP;
+  sws_event[1][SWS_MAX - 1] = SWS_EVENT_LOOP;
+#endif /* SW_SCOPE */
 
 #ifdef S_TIMER
   CONFIG_S_TIMER();
@@ -502,20 +523,26 @@ ISR(S_TIMER_COMP_vect)
 
 static uint16_t tx_setdelaytimeout = 2500;
 #ifdef SW_SCOPE
+// double buffered: the ISR logs into sws_event/sws_capture[sws_bank]; at the start of the next packet the bank
+// is handed over to the main loop (sws_block = 1, read by scopeRead()) and logging continues in the other bank;
+// if the main loop did not release the previous bank yet, the ISR does not wait but reuses its own bank (sws_dropped++)
 volatile byte sw_scope = 0;
 volatile byte sw_scope_next = 0;
 volatile byte sws_block = 0;
 volatile byte sws_error = 0;
 volatile byte sws_errorcount = 0;
-volatile uint8_t sws_event[SWS_MAX];
-volatile uint16_t sws_capture[SWS_MAX];
-volatile uint16_t sws_count[SWS_MAX];
-volatile uint8_t sws_cnt = 0;
+volatile uint8_t sws_event[2][SWS_MAX];
+volatile uint16_t sws_capture[2][SWS_MAX];
+volatile uint16_t sws_cnt = 0;
+volatile uint8_t sws_bank = 0;
+volatile uint16_t sws_ready_cnt = 0;
+static uint16_t sws_read_first = 0;
+volatile uint8_t sws_dropped = 0;
 
 #define SW_SCOPE_LOG_EVENT(capture, event)  \
     if (sw_scope && (sws_errorcount || !sws_error)) { \
-      sws_capture[sws_cnt] = capture; \
-      sws_event[sws_cnt] = event; \
+      sws_capture[sws_bank][sws_cnt] = capture; \
+      sws_event[sws_bank][sws_cnt] = event; \
       if (++sws_cnt == SWS_MAX) sws_cnt = 0; \
       if (sws_error) sws_errorcount--; \
     }
@@ -526,16 +553,24 @@ volatile uint8_t sws_cnt = 0;
         sws_error = 1; \
         sws_errorcount = SWS_MAX >> 1; \
       } \
-      sws_capture[sws_cnt] = capture; \
-      sws_event[sws_cnt] = event; \
+      sws_capture[sws_bank][sws_cnt] = capture; \
+      sws_event[sws_bank][sws_cnt] = event; \
       if (++sws_cnt == SWS_MAX) sws_cnt = 0; \
       if (sws_error) sws_errorcount--; \
     }
 
 #define SW_SCOPE_START_LOG { \
-        sws_block = 1; \
+        if (sws_cnt || (sws_event[sws_bank][SWS_MAX - 1] != SWS_EVENT_LOOP)) { \
+          if (sws_block) { \
+            sws_dropped++; \
+          } else { \
+            sws_ready_cnt = sws_cnt; \
+            sws_bank ^= 1; \
+            sws_block = 1; \
+          } \
+        } \
         sws_cnt = 0; \
-        sws_event[SWS_MAX - 1] = SWS_EVENT_LOOP; \
+        sws_event[sws_bank][SWS_MAX - 1] = SWS_EVENT_LOOP; \
         sws_error = 0; };
 
 #else /* SW_SCOPE */
@@ -573,10 +608,9 @@ ISR(MS_TIMER_COMP_vect)
       // switch from reading to writing
       // disable reading when writing
       // in scopemode, capture (both) edges
-      // if P1P2Monitor is still processing sws_event data (sws_block), do not start writing new events
 #ifdef SW_SCOPE
-      // if P1P2Monitor is ready reading data (sws_block = 0), start new log operation in write mode (if sw_scope_next)
-      sw_scope = sw_scope_next && !sws_block;
+      // start new log operation in write mode (if sw_scope_next), previous log is handed over to scopeRead()
+      sw_scope = sw_scope_next;
       if (sw_scope) {
         SW_SCOPE_START_LOG;
         // keep INT_INPUT_CAPTURE enabled
@@ -648,6 +682,17 @@ bool P1P2Serial::writeready(void)
   return (tx_buffer_tail == tx_buffer_head);
 }
 
+uint16_t P1P2Serial::pause_msec(void)
+// returns the pause on the bus (in ms) since the leading falling edge of the last start bit,
+// writepacket(t) called when the pause is already t or longer will not start writing until the delay timeout
+{
+  uint8_t intr_state = SREG;
+  cli();
+  uint16_t t = time_msec;
+  SREG = intr_state;
+  return t;
+}
+
 uint8_t tx_rx_paritycheck;
 uint8_t tx_rx_readbackerror;
 #ifdef GENERATE_FAKE_ERRORS
@@ -922,8 +967,45 @@ void P1P2Serial::setScope(byte b)
 // Set scope on or off (default off)
 // calling setScope has almost-immediate effect, starting from the next packet
 {
+  if (b && !sw_scope_next && !sw_scope) {
+    // the ISR does not log while the scope is off, discard the incomplete log left in its bank by the last stop
+    sws_cnt = 0;
+    sws_event[sws_bank][SWS_MAX - 1] = SWS_EVENT_LOOP;
+  }
   sw_scope_next = b;
 }
+
+uint16_t P1P2Serial::scopeRead(uint8_t &dropped)
+// returns the number of events in the last completed log (0 if no log is ready, SWS_MAX | 0x8000 if the ring wrapped and the oldest events were lost),
+// events are read in place by scopeEvent() (no copy), the log must be released by scopeRelease() afterwards
+// dropped: number of logs (packets) discarded because the previous log was not released yet, counter wraps at 256
+{
+  if (!sws_block) return 0;
+  // the ISR does not touch the handed over bank while sws_block is set
+  uint8_t bank = sws_bank ^ 1;
+  uint16_t n = sws_ready_cnt;
+  bool full = (sws_event[bank][SWS_MAX - 1] != SWS_EVENT_LOOP);
+  sws_read_first = full ? n : 0;
+  dropped = sws_dropped;
+  if (!full) return n;
+  return n ? (SWS_MAX | 0x8000) : SWS_MAX;
+}
+
+uint8_t P1P2Serial::scopeEvent(uint16_t i, uint16_t &capture)
+// returns the event code and capture of the i-th event (oldest first) of the log handed over by scopeRead()
+{
+  uint8_t bank = sws_bank ^ 1;
+  i += sws_read_first;
+  if (i >= SWS_MAX) i -= SWS_MAX;
+  capture = sws_capture[bank][i];
+  return sws_event[bank][i];
+}
+
+void P1P2Serial::scopeRelease(void)
+// releases the log handed over by scopeRead() for the ISR
+{
+  sws_block = 0;
+}
 #endif /* SW_SCOPE */
 
 void P1P2Serial::setEcho(uint8_t b)
@@ -990,8 +1072,8 @@ ISR(CAPTURE_INTERRUPT)
     SET_COMPARE_R(rx_target);
     ENABLE_INT_COMPARE_R(); // only needed in state = 0 but doesn't hurt to do it in state = 1
 #ifdef SW_SCOPE
-    // if P1P2Monitor is ready reading data (sws_block = 0), start new log operation
-    if ((state == 0) && !sws_block) {
+    // start new log operation, previous log is handed over to scopeRead()
+    if (state == 0) {
       sw_scope = sw_scope_next;
       if (sw_scope) SW_SCOPE_START_LOG;
     }
@@ -67,8 +67,15 @@
 #include "P1P2Serial_ADC.h"
 
 // Configuration options
-//#define MEASURE_LOAD                // measures irq processing time
-// #define SW_SCOPE                    // records timing info of P1/P2 bus falling edges of start of the packets
+#define SETTINGS_FUNCTIONALITY_ONLY
+#include "../../advanced_settings.h" // ENABLE_BUS_SCOPE is set in the sketch's advanced settings
+#undef SETTINGS_FUNCTIONALITY_ONLY
+#ifdef __AVR_ATmega2560__
+#define MEASURE_LOAD                // measures irq processing time (irq_r, irq_w, irq_lapsed_r, irq_lapsed_w), only read by the extended web UI
+#ifdef ENABLE_BUS_SCOPE
+#define SW_SCOPE                    // records timing info of P1/P2 bus edges (double buffered, read by scopeRead()), needs ~1.7 kB RAM
+#endif /* ENABLE_BUS_SCOPE */
+#endif /* __AVR_ATmega2560__ */
 //#define GENERATE_FAKE_ERRORS        // disable this for real use!! // only for NEWLIB, and on 8MHz this may add to the CPU load
 // #define SWS_FAKE_ERR_CNT 3000       // one fake error generated (per error type) per SWS_FAKE_ERR_CNT checks
 #define ALLOW_PAUSE_BETWEEN_BYTES 9 // If there is a pause between bytes on the bus which is longer than a 1/4 bit time,
@@ -117,15 +124,15 @@
 #endif /* GENERATE_FAKE_ERRORS */
 
 #ifdef MEASURE_LOAD
-extern volatile uint16_t irq_w, irq_r, irq_lapsed_w, irq_lapsed_r;
+extern volatile uint16_t irq_w, irq_r, irq_lapsed_w, irq_lapsed_r; // ISR time and duration (us) of the last packet read or written
 extern volatile uint8_t irq_busy;
 #endif
 
 //extern volatile uint8_t toolate;
 //extern volatile uint16_t lateness;
 
-#define SWS_MAX 22          // Max # SWS events recorded, limited by ATmega memory size (3 bytes/event) and serial output bandwidth
-                            // this cannot be much higher or time-info output overwhelms and crashes ESP8266, 21 is just over 1 byte timing info
+#define SWS_MAX 280         // Max # SWS events recorded per packet (3 bytes/event, 2 banks), ~11 events per byte,
+                            // enough for a whole read packet of 24 bytes (264 events), longer logs keep the newest events
                             // info exchange not very clean but using global variables
 
 #define SWS_EVENT_LOOP              0xF0 // stored in sws_event[SWS_MAX - 1] to indicate that <SWS_MAX events were recorded
@@ -153,10 +160,9 @@ extern volatile uint8_t irq_busy;
 #define errorbuf_t uint8_t
 #endif /* GENERATE_FAKE_ERRORS */
 
-extern volatile uint16_t sws_capture[SWS_MAX];
-extern volatile uint8_t sws_event[SWS_MAX];
-extern volatile uint8_t sws_cnt;
-extern volatile uint8_t sws_overflow;
+extern volatile uint16_t sws_capture[2][SWS_MAX];
+extern volatile uint8_t sws_event[2][SWS_MAX];
+extern volatile uint16_t sws_cnt;
 extern volatile byte sws_block;
 extern volatile byte sw_scope;
 //extern volatile uint16_t count;
@@ -177,11 +183,15 @@ public:
 	static void flushInput();
 	static void flushOutput();
 	static bool writeready();
+	static uint16_t pause_msec(); // returns time in ms since the last start bit on the bus
 	static void write(uint8_t byte);
 	static void setDelay(uint16_t t);
 	static void setDelayTimeout(uint16_t t);
 #ifdef SW_SCOPE
         static void setScope(byte b);
+        static uint16_t scopeRead(uint8_t &dropped);
+        static uint8_t scopeEvent(uint16_t i, uint16_t &capture);
+        static void scopeRelease();
 #endif /* SW_SCOPE */
 	static void setEcho(uint8_t b);
 	uint16_t readpacket(uint8_t* readbuf, uint16_t &delta, errorbuf_t* errorbuf, uint8_t maxlen, uint8_t crc_gen = 0, uint8_t crc_feed = 0);